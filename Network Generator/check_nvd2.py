@@ -0,0 +1,66 @@
+import gzip
+import os
+import shutil
+import sys
+import tempfile
+
+import nvd_stream
+from json_reader import FIELDS
+
+#Checks the NVD 2.0 path against the fixtures: fixtures/nvd2_page.json is an
+#API page and fixtures/nvd11_feed.json holds the same CVEs as a 1.1 feed.
+#Every entry point reads through nvd_stream, so the page has to come out of
+#it, plain, gzipped or as a directory, with the same fields as the 1.1 feed,
+#and a file with neither items array has to be an error.
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PAGE = os.path.join(HERE, 'fixtures', 'nvd2_page.json')
+FEED = os.path.join(HERE, 'fixtures', 'nvd11_feed.json')
+COMPARED = ('id', 'v3', 'vector', 'severity', 'v2', 'v2vector', 'cwe',
+            'published', 'modified', 'description')
+
+
+def fields(items):
+    return [{name: FIELDS[name](item) for name in COMPARED} for item in items]
+
+
+def cpes(items):
+    from cpe_index import iter_cpe_matches
+    return [sorted(m['cpe23Uri'] for m in iter_cpe_matches(item['configurations']['nodes']))
+            for item in items]
+
+
+def check():
+    expected = list(nvd_stream.iter_items(FEED))
+    page = list(nvd_stream.iter_items(PAGE))
+    assert len(page) == len(expected) == 3, (len(page), len(expected))
+    assert fields(page) == fields(expected)
+    assert cpes(page) == cpes(expected)
+
+    tmp = tempfile.mkdtemp()
+    try:
+        gz = os.path.join(tmp, 'page000.json.gz')
+        with open(PAGE, 'rb') as src, gzip.open(gz, 'wb') as dst:
+            shutil.copyfileobj(src, dst)
+        assert fields(nvd_stream.iter_items(gz)) == fields(expected)
+        shutil.copy(PAGE, os.path.join(tmp, 'page001.json'))
+        assert len(list(nvd_stream.iter_items(tmp))) == 2 * len(expected)
+
+        bad = os.path.join(tmp, 'other.txt')
+        with open(bad, 'w') as f:
+            f.write('{"resultsPerPage": 0}')
+        try:
+            list(nvd_stream.iter_items(bad))
+        except ValueError:
+            pass
+        else:
+            raise AssertionError("a file without an items array read as empty")
+    finally:
+        shutil.rmtree(tmp)
+
+
+#Usage: python check_nvd2.py
+if __name__ == "__main__":
+    check()
+    print("nvd2 fixtures ok")
+    sys.exit(0)
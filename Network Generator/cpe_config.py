@@ -0,0 +1,193 @@
+import random
+import sys
+import time
+from array import array
+
+from cpe_index import (in_bounds, iter_cpe_matches, parse_cpe, version_bounds,
+                       version_key)
+from nvd_stream import iter_items
+
+#Applicability of a CVE to a machine, from the configurations.nodes tree of
+#the feed. Each tree is compiled once into
+#
+#  leaves  one (vendor, product, version test) per distinct cpe_match
+#  ops     the AND/OR/NOT structure as a flat postfix program over leaves
+#
+#and the postfix program is turned into a single Python expression, so an
+#applicability test is a straight pass over the leaves followed by one
+#call, with no walking of nested dicts or re-parsing of cpe23Uri strings.
+#Version bounds (versionStartIncluding etc.) become interval checks on
+#pre-parsed version keys (cpe_index.version_key).
+#
+#Top level nodes are OR'ed together. A CVE applies when the expression is
+#true and at least one matching leaf is marked vulnerable, so platform-only
+#entries ("running on linux") never match by themselves.
+
+LEAF, AND, OR, NOT = 0, 1, 2, 3
+ANY = ('*', '-')
+BOUND_KEYS = ('versionStartIncluding', 'versionStartExcluding',
+              'versionEndIncluding', 'versionEndExcluding')
+
+
+class Inventory:
+    #software on one machine: (vendor, product) -> parsed versions
+    def __init__(self, cpes=()):
+        self.products = {}
+        for cpe in cpes:
+            self.add(cpe)
+
+    def add(self, cpe):
+        vendor, product, version = parse_cpe(cpe) if isinstance(cpe, str) else cpe
+        key = (vendor.lower(), product.lower())
+        self.products.setdefault(key, []).append(version_key(version))
+
+
+def _leaf(match):
+    vendor, product, version = parse_cpe(match['cpe23Uri'])
+    exact = None if version in ANY else version_key(version)
+    return ((vendor, product), exact) + version_bounds(match)
+
+
+def leaf_matches(leaf, products):
+    key, exact, lo, lo_incl, hi, hi_incl = leaf
+    versions = products.get(key)
+    if not versions:
+        return False
+    for v in versions:
+        if exact is not None and v != exact:
+            continue
+        if in_bounds(v, lo, lo_incl, hi, hi_incl):
+            return True
+    return False
+
+
+class Config:
+    __slots__ = ('leaves', 'vulnerable', 'ops', 'fn')
+
+    def __init__(self, nodes):
+        self.leaves = []
+        self.vulnerable = []
+        self.ops = array('I')
+        seen = {}
+        for node in nodes:
+            self._emit(node, seen)
+        self.ops.append(OR << 24 | len(nodes))
+        self.fn = _compile(self.ops)
+
+    def _emit(self, node, seen):
+        count = 0
+        for match in node.get('cpe_match', ()):
+            leaf = _leaf(match)
+            i = seen.get(leaf)
+            if i is None:
+                i = seen[leaf] = len(self.leaves)
+                self.leaves.append(leaf)
+                self.vulnerable.append(False)
+            if match.get('vulnerable', True):
+                self.vulnerable[i] = True
+            self.ops.append(LEAF << 24 | i)
+            count += 1
+        for child in node.get('children', ()):
+            self._emit(child, seen)
+            count += 1
+        op = AND if node.get('operator') == 'AND' else OR
+        self.ops.append(op << 24 | count)
+        if node.get('negate'):
+            self.ops.append(NOT << 24)
+
+    def applies(self, inventory):
+        products = inventory.products
+        m = [leaf_matches(leaf, products) for leaf in self.leaves]
+        if not self.fn(m):
+            return False
+        for hit, vuln in zip(m, self.vulnerable):
+            if hit and vuln:
+                return True
+        return False
+
+
+def _compile(ops):
+    #postfix program -> "lambda m: ..." with one m[i] per leaf
+    stack = []
+    for op in ops:
+        code, arg = op >> 24, op & 0xFFFFFF
+        if code == LEAF:
+            stack.append('m[%d]' % arg)
+        elif code == NOT:
+            stack.append('(not %s)' % stack.pop())
+        else:
+            args = stack[len(stack) - arg:]
+            del stack[len(stack) - arg:]
+            if not args:
+                stack.append('True' if code == AND else 'False')
+            else:
+                stack.append('(' + (' and ' if code == AND else ' or ').join(args) + ')')
+    return eval('lambda m: ' + stack.pop())
+
+
+def compile_item(item):
+    return Config(item.get('configurations', {}).get('nodes', ()))
+
+
+def compile_feed(items):
+    return [compile_item(item) for item in items]
+
+
+#Naive evaluation straight off the JSON tree, kept for the benchmark and as
+#the reference the compiled form is checked against.
+def _naive_node(node, inventory, hits):
+    results = []
+    for match in node.get('cpe_match', ()):
+        hit = leaf_matches(_leaf(match), inventory.products)
+        if hit and match.get('vulnerable', True):
+            hits.append(True)
+        results.append(hit)
+    for child in node.get('children', ()):
+        results.append(_naive_node(child, inventory, hits))
+    out = all(results) if node.get('operator') == 'AND' else any(results)
+    return not out if node.get('negate') else out
+
+
+def naive_applies(item, inventory):
+    hits = []
+    nodes = item.get('configurations', {}).get('nodes', ())
+    ok = any([_naive_node(node, inventory, hits) for node in nodes])
+    return ok and bool(hits)
+
+
+def bench(path, machines=200, per_machine=10, seed=1):
+    items = list(iter_items(path))
+    start = time.perf_counter()
+    configs = compile_feed(items)
+    compile_secs = time.perf_counter() - start
+
+    #inventories drawn from the products the feed mentions, with versions
+    #taken from the exact versions and range bounds it lists
+    rng = random.Random(seed)
+    pool = []
+    for item in items:
+        for match in iter_cpe_matches(item.get('configurations', {}).get('nodes', ())):
+            vendor, product, version = parse_cpe(match['cpe23Uri'])
+            for v in (version,) + tuple(match.get(k) for k in BOUND_KEYS):
+                if v is not None and v not in ANY:
+                    pool.append((vendor, product, v))
+    inventories = [Inventory(rng.sample(pool, min(per_machine, len(pool))))
+                   for _ in range(machines)]
+    tests = len(items) * machines
+
+    start = time.perf_counter()
+    naive = [[naive_applies(item, inv) for item in items] for inv in inventories]
+    naive_secs = time.perf_counter() - start
+    start = time.perf_counter()
+    compiled = [[cfg.applies(inv) for cfg in configs] for inv in inventories]
+    compiled_secs = time.perf_counter() - start
+
+    print("compiled %d configurations in %.3fs" % (len(configs), compile_secs))
+    print("naive     %d tests in %.3fs (%.0f/s)" % (tests, naive_secs, tests / naive_secs))
+    print("compiled  %d tests in %.3fs (%.0f/s)" % (tests, compiled_secs, tests / compiled_secs))
+    print("results match: %s, %d applicable" % (naive == compiled, sum(map(sum, compiled))))
+
+
+#Usage: python cpe_config.py feed.json
+if __name__ == "__main__":
+    bench(sys.argv[1])
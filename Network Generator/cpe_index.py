@@ -0,0 +1,228 @@
+import os
+import pickle
+import re
+import sys
+import time
+from array import array
+
+from nvd_stream import iter_items, source_stat
+from string_pool import POOL, pool_path
+
+#Index from affected products to CVEs, built from the cpe23Uri strings under
+#configurations.nodes[].cpe_match. Vendor, product and version strings are
+#interned to string_pool handles and the index is a hash on (vendor,
+#product) whose value maps version -> CVE rows. Versions are stored and
+#looked up in canonical form, so "10.5.0" finds a match listed as "10.5".
+#The saved index keeps the handles as they are, against the shared
+#string_pool file next to it. Matches whose version is
+#'*' or '-' apply to every version of the product and are kept in a
+#separate list, unless they carry versionStart*/versionEnd* bounds: those
+#go to a per-product range list and only match versions inside the bounds.
+#Rows are positions in feed order, the same as the rows of nvd_cache.
+#
+#Each cpe_match is tested on its own: AND nodes ("firmware X on hardware Y")
+#are not evaluated, so a hit on such a CVE is a candidate that cpe_config
+#has to confirm, which is what inventory_join does.
+#
+#A machine inventory is a list of cpe23Uri strings (or (vendor, product,
+#version) tuples). Bulk joins memoize each distinct product so a network of
+#identical PCs only costs one lookup per distinct piece of software.
+
+INDEX_VERSION = 7
+ANY = ('*', '-')
+OPEN = (None, False, None, False)
+END = (0,)
+PRE_RELEASE = {'dev': 0, 'snapshot': 0, 'alpha': 1, 'beta': 2, 'pre': 3,
+               'preview': 3, 'rc': 4, 'cr': 4}
+
+_split = re.compile(r'(?<!\\):').split
+_version_part = re.compile(r'\d+|[a-z]+')
+
+
+def parse_cpe(uri):
+    #cpe:2.3:part:vendor:product:version:update:...
+    parts = _split(uri)
+    if len(parts) < 6 or parts[0] != 'cpe':
+        raise ValueError("bad cpe23Uri: %s" % uri)
+    return parts[3].lower(), parts[4].lower(), parts[5].lower()
+
+
+def version_key(version):
+    #"10.2.0" and "10.2" give the same key; "2.0rc1" and "2.0-beta" sort
+    #below "2.0", other letter suffixes ("1.0.2k") above it
+    key = []
+    run = []
+    parts = _version_part.findall(version.lower())
+    for i, p in enumerate(parts):
+        if p.isdigit():
+            run.append(int(p))
+            continue
+        while run and run[-1] == 0:
+            run.pop()
+        key.extend((2, n) for n in run)
+        run = []
+        rank = PRE_RELEASE.get(p)
+        if rank is None and p in ('a', 'b', 'c') and i + 1 < len(parts) and parts[i + 1].isdigit():
+            rank = PRE_RELEASE[{'a': 'alpha', 'b': 'beta', 'c': 'rc'}[p]]
+        key.append((1, p) if rank is None else (-1, rank))
+    while run and run[-1] == 0:
+        run.pop()
+    key.extend((2, n) for n in run)
+    key.append(END)
+    return tuple(key)
+
+
+def canonical_version(version):
+    #one string per version_key: numbers and words joined by '.', a
+    #pre-release tag as '~rank'
+    return '.'.join(str(p[1]) if p[0] > 0 else '~%d' % p[1]
+                    for p in version_key(version)[:-1])
+
+
+def version_bounds(match):
+    #(lo, lo_incl, hi, hi_incl) version keys of a cpe_match, None when open
+    lo = match.get('versionStartIncluding')
+    lo_incl = lo is not None
+    if lo is None:
+        lo = match.get('versionStartExcluding')
+    hi = match.get('versionEndIncluding')
+    hi_incl = hi is not None
+    if hi is None:
+        hi = match.get('versionEndExcluding')
+    return (None if lo is None else version_key(lo), lo_incl,
+            None if hi is None else version_key(hi), hi_incl)
+
+
+def in_bounds(v, lo, lo_incl, hi, hi_incl):
+    if lo is not None and (v < lo if lo_incl else v <= lo):
+        return False
+    if hi is not None and (v > hi if hi_incl else v >= hi):
+        return False
+    return True
+
+
+def iter_cpe_matches(nodes):
+    for node in nodes:
+        yield from node.get('cpe_match', ())
+        yield from iter_cpe_matches(node.get('children', ()))
+
+
+class CpeIndex:
+    def __init__(self, pool=POOL):
+        self.pool = pool
+        self.ids = []
+        self.products = {}
+        self.ranges = {}        #(vendor, product) -> [(lo, lo_incl, hi, hi_incl, row)]
+
+    def intern(self, s):
+        return self.pool.intern(s)
+
+    def add_item(self, item):
+        row = len(self.ids)
+        self.ids.append(item['cve']['CVE_data_meta']['ID'])
+        seen = set()
+        nodes = item.get('configurations', {}).get('nodes', ())
+        for match in iter_cpe_matches(nodes):
+            if not match.get('vulnerable', True):
+                continue
+            vendor, product, version = parse_cpe(match['cpe23Uri'])
+            key = (self.intern(vendor), self.intern(product))
+            if version in ANY:
+                bounds = version_bounds(match)
+                if bounds != OPEN:
+                    if (key, bounds) not in seen:
+                        seen.add((key, bounds))
+                        self.ranges.setdefault(key, []).append(bounds + (row,))
+                    continue
+            ver = -1 if version in ANY else self.intern(canonical_version(version))
+            if (key, ver) in seen:
+                continue
+            seen.add((key, ver))
+            versions = self.products.get(key)
+            if versions is None:
+                versions = self.products[key] = {}
+            rows = versions.get(ver)
+            if rows is None:
+                rows = versions[ver] = array('I')
+            rows.append(row)
+
+    def lookup(self, vendor, product, version):
+        #rows of CVEs listing this product at this version, at any version,
+        #or in a version range that holds this version
+        key = (self.pool.get(vendor), self.pool.get(product))
+        versions = self.products.get(key, {})
+        out = versions.get(-1, ())
+        h = None if version in ANY else self.pool.get(canonical_version(version))
+        if h is not None and h in versions:
+            out = versions[h] if not out else sorted(set(out).union(versions[h]))
+        ranges = self.ranges.get(key)
+        if ranges and version not in ANY:
+            v = version_key(version)
+            hits = [r[4] for r in ranges if in_bounds(v, *r[:4])]
+            if hits:
+                out = sorted(set(out).union(hits))
+        return out
+
+    def join(self, inventories):
+        #inventories: one list of cpes per machine -> sorted CVE rows per machine
+        memo = {}
+        out = []
+        for software in inventories:
+            rows = set()
+            for cpe in software:
+                hit = memo.get(cpe)
+                if hit is None:
+                    v, p, ver = parse_cpe(cpe) if isinstance(cpe, str) else cpe
+                    hit = memo[cpe] = self.lookup(v.lower(), p.lower(), ver.lower())
+                rows.update(hit)
+            out.append(sorted(rows))
+        return out
+
+    def save(self, path):
+        token = self.pool.persist(pool_path(path))
+        with open(path, 'wb') as f:
+            pickle.dump((INDEX_VERSION, token, len(self.pool), self.ids,
+                         self.products, self.ranges), f, protocol=pickle.HIGHEST_PROTOCOL)
+
+    @classmethod
+    def load(cls, path, pool=POOL):
+        with open(path, 'rb') as f:
+            version, token, size, ids, products, ranges = pickle.load(f)
+        if version != INDEX_VERSION:
+            raise ValueError("stale CPE index %s" % path)
+        pool.check(path, token, size)
+        idx = cls(pool)
+        idx.ids, idx.products, idx.ranges = ids, products, ranges
+        return idx
+
+
+def build_index(items):
+    idx = CpeIndex()
+    for item in items:
+        idx.add_item(item)
+    return idx
+
+
+def load_index(feed_path, index_path=None):
+    if index_path is None:
+        index_path = feed_path + '.cpeidx'
+    try:
+        if os.stat(index_path).st_mtime_ns >= source_stat(feed_path)[1]:
+            return CpeIndex.load(index_path)
+    except (OSError, ValueError):
+        pass
+    POOL.prepare(index_path)
+    idx = build_index(iter_items(feed_path))
+    idx.save(index_path)
+    return idx
+
+
+#Usage: python cpe_index.py feed.json cpe23Uri [cpe23Uri ...]
+if __name__ == "__main__":
+    start = time.perf_counter()
+    idx = load_index(sys.argv[1])
+    print("%d CVEs, %d products indexed in %.3fs"
+          % (len(idx.ids), len(idx.products.keys() | idx.ranges.keys()),
+             time.perf_counter() - start))
+    for row in idx.join([sys.argv[2:]])[0]:
+        print(idx.ids[row])
@@ -0,0 +1,217 @@
+import mmap
+import multiprocessing
+import os
+import struct
+import sys
+import time
+from array import array
+from collections import Counter
+from concurrent.futures import ProcessPoolExecutor
+from operator import add
+
+#Compressed sparse row adjacency for the generated networks: the neighbors
+#of node v are nbrs[offsets[v]:offsets[v + 1]]. Graphs are undirected, so
+#each edge appears in both endpoints' lists.
+#
+#from_edges is a two pass counting sort over an edge list. The edges are cut
+#into chunks; workers count the endpoint degrees of their chunk, the parent
+#turns the counts into a start position per chunk and node, and the workers
+#then write their chunk straight into a shared anonymous mmap. Each list
+#keeps the edge order of the input, so the result does not depend on the
+#number of workers.
+#
+#On disk a graph is a header and the two arrays, and load() maps the file
+#instead of reading it, like nvd_cache.
+
+MAGIC = b'NVDG'
+HEADER = struct.Struct('<4sIQQ')    #magic, version, nodes, entries
+FORMAT_VERSION = 1
+
+_src = _dst = _out = None
+
+
+def _count(lo, hi, n):
+    c = Counter(_src[lo:hi])
+    c.update(_dst[lo:hi])
+    deg = array('I', bytes(4 * n))
+    for v, k in c.items():
+        deg[v] = k
+    return deg
+
+
+def _scatter(lo, hi, cursor):
+    out = _out
+    for s, d in zip(_src[lo:hi], _dst[lo:hi]):
+        out[cursor[s]] = d
+        cursor[s] += 1
+        out[cursor[d]] = s
+        cursor[d] += 1
+
+
+class CSR:
+    def __init__(self, offsets, nbrs, mm=None):
+        self.offsets = offsets
+        self.nbrs = nbrs
+        self.n = len(offsets) - 1
+        self._mm = mm
+
+    def __len__(self):
+        return self.n
+
+    def edges(self):
+        return len(self.nbrs) // 2
+
+    def degree(self, v):
+        return self.offsets[v + 1] - self.offsets[v]
+
+    def neighbors(self, v):
+        return self.nbrs[self.offsets[v]:self.offsets[v + 1]]
+
+    def save(self, path):
+        tmp = path + '.tmp'
+        with open(tmp, 'wb') as f:
+            f.write(HEADER.pack(MAGIC, FORMAT_VERSION, self.n, len(self.nbrs)))
+            f.write(memoryview(self.offsets).cast('B'))
+            f.write(memoryview(self.nbrs).cast('B'))
+        os.replace(tmp, path)
+
+    @classmethod
+    def load(cls, path):
+        with open(path, 'rb') as f:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, n, entries = HEADER.unpack_from(mm, 0)
+        if magic != MAGIC or version != FORMAT_VERSION:
+            mm.close()
+            raise ValueError("%s is not a graph file" % path)
+        buf = memoryview(mm)
+        start = HEADER.size
+        offsets = buf[start:start + 8 * (n + 1)].cast('Q')
+        start += 8 * (n + 1)
+        nbrs = buf[start:start + 4 * entries].cast('I')
+        return cls(offsets, nbrs, mm)
+
+    def close(self):
+        if self._mm is not None:
+            self.offsets.release()
+            self.nbrs.release()
+            self._mm.close()
+            self._mm = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def bfs(self, sources, max_depth=None):
+        #hop distance from the nearest source, -1 where unreachable
+        off, nbrs = self.offsets, self.nbrs
+        dist = array('i', [-1]) * self.n
+        frontier = list(sources)
+        for v in frontier:
+            dist[v] = 0
+        depth = 0
+        while frontier and (max_depth is None or depth < max_depth):
+            depth += 1
+            nxt = []
+            for v in frontier:
+                for u in nbrs[off[v]:off[v + 1]]:
+                    if dist[u] < 0:
+                        dist[u] = depth
+                        nxt.append(u)
+            frontier = nxt
+        return dist
+
+    def components(self):
+        #(label per node, number of components); labels count up from 0
+        off, nbrs = self.offsets, self.nbrs
+        label = array('i', [-1]) * self.n
+        count = 0
+        for root in range(self.n):
+            if label[root] >= 0:
+                continue
+            label[root] = count
+            stack = [root]
+            while stack:
+                v = stack.pop()
+                for u in nbrs[off[v]:off[v + 1]]:
+                    if label[u] < 0:
+                        label[u] = count
+                        stack.append(u)
+            count += 1
+        return label, count
+
+    def propagate(self, hazard, decay=0.5, steps=3):
+        #diffuses per node hazard (e.g. summed CVSS) to the neighbors:
+        #h = hazard + decay * (each neighbor's h shared over its degree),
+        #iterated steps times; decay < 1 keeps the totals bounded
+        off, nbrs = self.offsets, self.nbrs
+        n = self.n
+        h = array('d', hazard)
+        for _ in range(steps):
+            share = array('d', (h[v] / (off[v + 1] - off[v]) if off[v + 1] > off[v] else 0.0
+                                for v in range(n)))
+            h = array('d', (hazard[v] + decay * sum(share[u] for u in nbrs[off[v]:off[v + 1]])
+                            for v in range(n)))
+        return h
+
+
+def from_edges(n, src, dst, workers=1, chunks=None):
+    global _src, _dst, _out
+    m = len(src)
+    chunks = chunks or max(1, workers) * 4
+    size = max(1, -(-m // chunks))
+    bounds = [(lo, min(m, lo + size)) for lo in range(0, m, size)]
+    _src, _dst = src, dst
+    pool = None
+    if workers > 1 and len(bounds) > 1:
+        mm = mmap.mmap(-1, 8 * m)
+        _out = memoryview(mm).cast('I')
+        pool = ProcessPoolExecutor(max_workers=workers,
+                                   mp_context=multiprocessing.get_context('fork'))
+        counts = list(pool.map(_count, *zip(*[(lo, hi, n) for lo, hi in bounds])))
+    else:
+        _out = array('I', bytes(8 * m))
+        counts = [_count(lo, hi, n) for lo, hi in bounds]
+    try:
+        deg = array('Q', bytes(8 * n))
+        for c in counts:
+            deg = array('Q', map(add, deg, c))
+        offsets = array('Q', [0])
+        total = 0
+        for d in deg:
+            total += d
+            offsets.append(total)
+        cursors = []
+        cur = offsets[:-1]
+        for c in counts:
+            cursors.append(cur)
+            cur = array('Q', map(add, cur, c))
+        jobs = [(lo, hi, cursor) for (lo, hi), cursor in zip(bounds, cursors)]
+        if pool is not None:
+            list(pool.map(_scatter, *zip(*jobs)))
+            _out.release()
+            nbrs = array('I')
+            nbrs.frombytes(mm[:8 * m])
+            mm.close()
+        else:
+            for job in jobs:
+                _scatter(*job)
+            nbrs = _out
+    finally:
+        if pool is not None:
+            pool.shutdown()
+        _src = _dst = _out = None
+    return CSR(offsets, nbrs)
+
+
+#Usage: python csr.py graph_file
+#prints size, components and the BFS reach of node 0 of a saved graph
+if __name__ == "__main__":
+    start = time.perf_counter()
+    with CSR.load(sys.argv[1]) as g:
+        labels, count = g.components()
+        dist = g.bfs([0]) if g.n else array('i')
+        print("%d nodes, %d edges, %d components, %d reachable from node 0 in %.3fs"
+              % (g.n, g.edges(), count, sum(1 for d in dist if d >= 0),
+                 time.perf_counter() - start))
@@ -0,0 +1,269 @@
+import math
+import sys
+import time
+from array import array
+
+#CVSS vector strings packed into small integers. Each metric value is stored
+#as its index in the tables below, metrics are laid out low bit first in
+#table order and the top bit marks that a vector was present, so 0 means
+#"no vector". Temporal metrics sit above the base ones with 'X'/'ND' (not
+#defined) as index 0, so a plain base vector packs the same either way.
+#
+#Environmental metrics are not part of the packed code. They describe our
+#own network rather than the vulnerability, so they are passed in as a
+#profile and applied to every code at scoring time.
+
+V3_METRICS = [
+    ('AV', ('N', 'A', 'L', 'P')),
+    ('AC', ('L', 'H')),
+    ('PR', ('N', 'L', 'H')),
+    ('UI', ('N', 'R')),
+    ('S', ('U', 'C')),
+    ('C', ('H', 'L', 'N')),
+    ('I', ('H', 'L', 'N')),
+    ('A', ('H', 'L', 'N')),
+    ('E', ('X', 'U', 'P', 'F', 'H')),
+    ('RL', ('X', 'O', 'T', 'W', 'U')),
+    ('RC', ('X', 'U', 'R', 'C')),
+]
+
+V2_METRICS = [
+    ('AV', ('L', 'A', 'N')),
+    ('AC', ('H', 'M', 'L')),
+    ('Au', ('M', 'S', 'N')),
+    ('C', ('N', 'P', 'C')),
+    ('I', ('N', 'P', 'C')),
+    ('A', ('N', 'P', 'C')),
+    ('E', ('ND', 'U', 'POC', 'F', 'H')),
+    ('RL', ('ND', 'OF', 'TF', 'W', 'U')),
+    ('RC', ('ND', 'UC', 'UR', 'C')),
+]
+
+PRESENT = 1 << 31
+V3_0 = 1 << 30          #vector was CVSS:3.0, which rounds differently
+
+NO_SCORE = 0xFFFF       #fixed point "no score", see nvd_cache
+
+
+def _layout(metrics):
+    out = {}
+    shift = 0
+    for name, values in metrics:
+        bits = (len(values) - 1).bit_length()
+        out[name] = (shift, (1 << bits) - 1, values,
+                     {v: i for i, v in enumerate(values)})
+        shift += bits
+    return out
+
+
+V3_LAYOUT = _layout(V3_METRICS)
+V2_LAYOUT = _layout(V2_METRICS)
+
+
+def _pack(vector, layout):
+    code = PRESENT
+    for part in vector.split('/'):
+        name, _, value = part.partition(':')
+        field = layout.get(name)
+        if field is None:
+            continue
+        shift, mask, values, index = field
+        idx = index.get(value)
+        if idx is None:
+            raise ValueError("bad CVSS metric %s in %s" % (part, vector))
+        code |= idx << shift
+    return code
+
+
+def _unpack(code, layout):
+    if not code & PRESENT:
+        return None
+    return {name: values[(code >> shift) & mask]
+            for name, (shift, mask, values, _) in layout.items()}
+
+
+def pack_v3(vector):
+    if not vector:
+        return 0
+    code = _pack(vector, V3_LAYOUT)
+    if vector.startswith('CVSS:3.0/'):
+        code |= V3_0
+    return code
+
+
+def pack_v2(vector):
+    return _pack(vector, V2_LAYOUT) if vector else 0
+
+
+def unpack_v3(code):
+    return _unpack(code, V3_LAYOUT)
+
+
+def unpack_v2(code):
+    return _unpack(code, V2_LAYOUT)
+
+
+#CVSS v3.x weights, from the v3.1 specification section 7.4
+W3 = {
+    'AV': {'N': 0.85, 'A': 0.62, 'L': 0.55, 'P': 0.2},
+    'AC': {'L': 0.77, 'H': 0.44},
+    'UI': {'N': 0.85, 'R': 0.62},
+    'CIA': {'H': 0.56, 'L': 0.22, 'N': 0.0},
+    'E': {'X': 1.0, 'H': 1.0, 'F': 0.97, 'P': 0.94, 'U': 0.91},
+    'RL': {'X': 1.0, 'U': 1.0, 'W': 0.97, 'T': 0.96, 'O': 0.95},
+    'RC': {'X': 1.0, 'C': 1.0, 'R': 0.96, 'U': 0.92},
+    'REQ': {'X': 1.0, 'H': 1.5, 'M': 1.0, 'L': 0.5},
+}
+PR_UNCHANGED = {'N': 0.85, 'L': 0.62, 'H': 0.27}
+PR_CHANGED = {'N': 0.85, 'L': 0.68, 'H': 0.5}
+
+
+def roundup_v30(x):
+    return math.ceil(x * 10) / 10
+
+
+def roundup_v31(x):
+    #float safe round up to one decimal, v3.1 specification appendix A
+    i = int(round(x * 100000))
+    if i % 10000 == 0:
+        return i / 100000.0
+    return (math.floor(i / 10000) + 1) / 10.0
+
+
+def score_v3(code, profile=None):
+    #returns (base, temporal, environmental) for a packed v3 vector
+    m = unpack_v3(code)
+    if m is None:
+        return None
+    profile = profile or {}
+    roundup = roundup_v30 if code & V3_0 else roundup_v31
+    changed = m['S'] == 'C'
+    pr = PR_CHANGED if changed else PR_UNCHANGED
+
+    iss = 1 - ((1 - W3['CIA'][m['C']]) * (1 - W3['CIA'][m['I']])
+               * (1 - W3['CIA'][m['A']]))
+    if changed:
+        impact = 7.52 * (iss - 0.029) - 3.25 * (iss - 0.02) ** 15
+    else:
+        impact = 6.42 * iss
+    expl = 8.22 * W3['AV'][m['AV']] * W3['AC'][m['AC']] * pr[m['PR']] * W3['UI'][m['UI']]
+    if impact <= 0:
+        base = 0.0
+    elif changed:
+        base = roundup(min(1.08 * (impact + expl), 10))
+    else:
+        base = roundup(min(impact + expl, 10))
+
+    #the profile may supply temporal values the vector leaves undefined
+    tm = {k: (m[k] if m[k] != 'X' else profile.get(k, 'X')) for k in ('E', 'RL', 'RC')}
+    tmul = W3['E'][tm['E']] * W3['RL'][tm['RL']] * W3['RC'][tm['RC']]
+    temporal = roundup(base * tmul)
+
+    def mod(name):
+        v = profile.get('M' + name, 'X')
+        return m[name] if v == 'X' else v
+
+    mchanged = mod('S') == 'C'
+    mpr = PR_CHANGED if mchanged else PR_UNCHANGED
+    miss = min(1 - (1 - W3['REQ'][profile.get('CR', 'X')] * W3['CIA'][mod('C')])
+               * (1 - W3['REQ'][profile.get('IR', 'X')] * W3['CIA'][mod('I')])
+               * (1 - W3['REQ'][profile.get('AR', 'X')] * W3['CIA'][mod('A')]), 0.915)
+    if mchanged:
+        if code & V3_0:
+            mimpact = 7.52 * (miss - 0.029) - 3.25 * (miss - 0.02) ** 15
+        else:
+            mimpact = 7.52 * (miss - 0.029) - 3.25 * (miss * 0.9731 - 0.02) ** 13
+    else:
+        mimpact = 6.42 * miss
+    mexpl = (8.22 * W3['AV'][mod('AV')] * W3['AC'][mod('AC')]
+             * mpr[mod('PR')] * W3['UI'][mod('UI')])
+    if mimpact <= 0:
+        env = 0.0
+    elif mchanged:
+        env = roundup(roundup(min(1.08 * (mimpact + mexpl), 10)) * tmul)
+    else:
+        env = roundup(roundup(min(mimpact + mexpl, 10)) * tmul)
+    return base, temporal, env
+
+
+#CVSS v2 weights, from the v2 guide section 3.2
+W2 = {
+    'AV': {'L': 0.395, 'A': 0.646, 'N': 1.0},
+    'AC': {'H': 0.35, 'M': 0.61, 'L': 0.71},
+    'Au': {'M': 0.45, 'S': 0.56, 'N': 0.704},
+    'CIA': {'N': 0.0, 'P': 0.275, 'C': 0.660},
+    'E': {'ND': 1.0, 'U': 0.85, 'POC': 0.9, 'F': 0.95, 'H': 1.0},
+    'RL': {'ND': 1.0, 'OF': 0.87, 'TF': 0.9, 'W': 0.95, 'U': 1.0},
+    'RC': {'ND': 1.0, 'UC': 0.9, 'UR': 0.95, 'C': 1.0},
+    'CDP': {'ND': 0.0, 'N': 0.0, 'L': 0.1, 'LM': 0.3, 'MH': 0.4, 'H': 0.5},
+    'TD': {'ND': 1.0, 'N': 0.0, 'L': 0.25, 'M': 0.75, 'H': 1.0},
+    'REQ': {'ND': 1.0, 'L': 0.5, 'M': 1.0, 'H': 1.51},
+}
+
+
+def round1(x):
+    return math.floor(x * 10 + 0.5 + 1e-9) / 10
+
+
+def score_v2(code, profile=None):
+    m = unpack_v2(code)
+    if m is None:
+        return None
+    profile = profile or {}
+    c, i, a = W2['CIA'][m['C']], W2['CIA'][m['I']], W2['CIA'][m['A']]
+    expl = 20 * W2['AV'][m['AV']] * W2['AC'][m['AC']] * W2['Au'][m['Au']]
+
+    def base_of(impact):
+        f = 0 if impact == 0 else 1.176
+        return round1(((0.6 * impact) + (0.4 * expl) - 1.5) * f)
+
+    base = base_of(10.41 * (1 - (1 - c) * (1 - i) * (1 - a)))
+    tm = {k: (m[k] if m[k] != 'ND' else profile.get(k, 'ND')) for k in ('E', 'RL', 'RC')}
+    tmul = W2['E'][tm['E']] * W2['RL'][tm['RL']] * W2['RC'][tm['RC']]
+    temporal = round1(base * tmul)
+
+    adj_impact = min(10, 10.41 * (1 - (1 - c * W2['REQ'][profile.get('CR', 'ND')])
+                                  * (1 - i * W2['REQ'][profile.get('IR', 'ND')])
+                                  * (1 - a * W2['REQ'][profile.get('AR', 'ND')])))
+    adj_temporal = round1(base_of(adj_impact) * tmul)
+    cdp = W2['CDP'][profile.get('CDP', 'ND')]
+    td = W2['TD'][profile.get('TD', 'ND')]
+    env = round1((adj_temporal + (10 - adj_temporal) * cdp) * td)
+    return base, temporal, env
+
+
+BASE, TEMPORAL, ENVIRONMENTAL = 0, 1, 2
+
+
+def score_batch(codes, profile=None, kind=ENVIRONMENTAL, v2=False):
+    #Scores a whole column of packed vectors as fixed point tenths. A corpus
+    #only holds a few thousand distinct vectors, so each distinct code is
+    #scored once and the column is filled from that table.
+    fn = score_v2 if v2 else score_v3
+    table = {0: NO_SCORE}
+    out = array('H', bytes(2 * len(codes)))
+    for n, code in enumerate(codes):
+        s = table.get(code)
+        if s is None:
+            s = table[code] = int(round(fn(code, profile)[kind] * 10))
+        out[n] = s
+    return out
+
+
+def parse_profile(args):
+    #['CR:H', 'MAV:L'] -> {'CR': 'H', 'MAV': 'L'}
+    return dict(arg.split(':', 1) for arg in args)
+
+
+#Usage: python cvss.py feed.json [METRIC:VALUE ...]
+#re-scores every v3 vector in the feed under the given environmental profile
+if __name__ == "__main__":
+    from nvd_cache import load_cache
+    profile = parse_profile(sys.argv[2:])
+    with load_cache(sys.argv[1]) as cache:
+        start = time.perf_counter()
+        scores = score_batch(cache.v3_vector, profile)
+        secs = time.perf_counter() - start
+        print("%d vectors re-scored in %.3fs" % (len(scores), secs))
+        changed = sum(1 for s, b in zip(scores, cache.v3_base) if s != b)
+        print("%d scores differ from the feed's base score" % changed)
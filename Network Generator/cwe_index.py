@@ -0,0 +1,171 @@
+import os
+import pickle
+import sys
+
+from nvd_stream import iter_feeds
+from string_pool import POOL, pool_path
+
+#CWE -> CVE posting index with per-CWE aggregates, from
+#problemtype.problemtype_data[].description[].value ("CWE-306",
+#"NVD-CWE-Other", ...). CWE strings are interned in the string_pool and
+#every table below is keyed on the pool handle; the file is pickled with
+#those handles as they are, against the shared pool file next to it. The
+#index cannot be rebuilt from a feed, so it also keeps the name of each
+#handle and re-keys on those if the pool file no longer matches.
+#
+#Each CVE's current CWEs and v3 score are remembered, so update() can take
+#just the changed items of an nvd_store merge: the old contribution is
+#taken out of the count/sum and the new one added. A max only has to be
+#recomputed when the CVE holding it changes.
+
+INDEX_VERSION = 5
+STATE = ('postings', 'count', 'scored', 'total', 'best', 'cves')
+
+
+def _tenths(score):
+    #scores are summed as integers so that repeated updates cannot drift
+    return None if score is None else int(round(score * 10))
+
+
+def _rekey(state, h):
+    #state with every handle passed through h
+    out = {name: {h(k): v for k, v in state[name].items()}
+           for name in ('postings', 'count', 'scored', 'total', 'best')}
+    out['cves'] = {cve_id: (tuple(h(k) for k in handles), score)
+                   for cve_id, (handles, score) in state['cves'].items()}
+    return out
+
+
+def cwes_of(item):
+    out = []
+    for pt in item['cve']['problemtype']['problemtype_data']:
+        for desc in pt['description']:
+            if desc['value'] not in out:
+                out.append(desc['value'])
+    return out
+
+
+def v3_of(item):
+    m3 = item.get('impact', {}).get('baseMetricV3')
+    return m3['cvssV3']['baseScore'] if m3 else None
+
+
+class CweIndex:
+    def __init__(self, pool=POOL):
+        self.pool = pool
+        self.postings = {}      #handle -> set of CVE IDs
+        self.count = {}
+        self.scored = {}        #CVEs with a v3 score
+        self.total = {}         #sum of their v3 scores, in integer tenths
+        self.best = {}          #max v3 score, None when stale
+        self.cves = {}          #CVE ID -> (handles, v3 score)
+
+    def intern(self, name):
+        h = self.pool.intern(name)
+        if h not in self.postings:
+            self.postings[h] = set()
+            self.count[h] = 0
+            self.scored[h] = 0
+            self.total[h] = 0
+            self.best[h] = 0.0
+        return h
+
+    def _remove(self, cve_id):
+        old = self.cves.pop(cve_id, None)
+        if old is None:
+            return
+        handles, score = old
+        tenths = _tenths(score)
+        for h in handles:
+            self.postings[h].discard(cve_id)
+            self.count[h] -= 1
+            if score is not None:
+                self.scored[h] -= 1
+                self.total[h] -= tenths
+                if score >= (self.best[h] or 0.0):
+                    self.best[h] = None
+
+    def update(self, items):
+        for item in items:
+            cve_id = item['cve']['CVE_data_meta']['ID']
+            self._remove(cve_id)
+            score = v3_of(item)
+            handles = tuple(self.intern(name) for name in cwes_of(item))
+            self.cves[cve_id] = (handles, score)
+            tenths = _tenths(score)
+            for h in handles:
+                self.postings[h].add(cve_id)
+                self.count[h] += 1
+                if score is not None:
+                    self.scored[h] += 1
+                    self.total[h] += tenths
+                    if self.best[h] is not None and score > self.best[h]:
+                        self.best[h] = score
+
+    def apply_changes(self, store, changes):
+        #changes: the (ID, kind) list returned by nvd_store.Store.merge
+        self.update(store.get(cve_id) for cve_id, _ in changes)
+
+    def max_v3(self, h):
+        if self.best[h] is None:
+            scores = [self.cves[c][1] for c in self.postings[h]]
+            self.best[h] = max((s for s in scores if s is not None), default=0.0)
+        return self.best[h]
+
+    def cves_of(self, name):
+        h = self.pool.get(name)
+        return sorted(self.postings[h]) if h in self.postings else []
+
+    def summary(self, name):
+        #(count, mean v3, max v3) for one CWE
+        h = self.pool.get(name)
+        mean = self.total[h] / self.scored[h] / 10 if self.scored[h] else 0.0
+        return self.count[h], mean, self.max_v3(h)
+
+    def report(self):
+        #[(CWE, count, mean v3, max v3)] largest classes first
+        rows = [(self.pool[h],) + self.summary(self.pool[h])
+                for h in self.postings if self.count[h]]
+        rows.sort(key=lambda r: (-r[1], r[0]))
+        return rows
+
+    def save(self, path):
+        for h in self.postings:
+            self.max_v3(h)
+        token = self.pool.persist(pool_path(path))
+        state = {name: self.__dict__[name] for name in STATE}
+        names = {h: self.pool[h] for h in self.postings}
+        tmp = path + '.tmp'
+        with open(tmp, 'wb') as f:
+            pickle.dump((INDEX_VERSION, token, len(self.pool), names, state), f,
+                        protocol=pickle.HIGHEST_PROTOCOL)
+        os.replace(tmp, path)
+
+    @classmethod
+    def load(cls, path, pool=POOL):
+        idx = cls(pool)
+        try:
+            with open(path, 'rb') as f:
+                version, token, size, names, state = pickle.load(f)
+        except FileNotFoundError:
+            pool.attach(pool_path(path))
+            return idx
+        if version != INDEX_VERSION:
+            raise ValueError("stale CWE index %s" % path)
+        try:
+            pool.check(path, token, size)
+        except ValueError:
+            state = _rekey(state, lambda h: pool.intern(names[h]))
+        idx.__dict__.update(state)
+        return idx
+
+
+#Usage: python cwe_index.py index_file [feed.json ...]
+#folds the feeds into the index and prints the per-CWE roll up
+if __name__ == "__main__":
+    idx = CweIndex.load(sys.argv[1])
+    if len(sys.argv) > 2:
+        idx.update(iter_feeds(sys.argv[2:]))
+        idx.save(sys.argv[1])
+    for name, count, mean, best in idx.report():
+        print("%-16s %6d CVEs  mean v3 %.2f  max v3 %.1f" % (name, count, mean, best))
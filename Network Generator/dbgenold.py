@@ -1,45 +1,230 @@
+import random
+import time
+from array import array
+from concurrent.futures import ProcessPoolExecutor
+
+import csr
+
+#Typed multi-network generator. Every node of every network lives in one
+#NodeStore as parallel arrays (type, vulnerability lists, edges), so millions
+#of nodes cost a few bytes each instead of a Python object apiece. node and
+#net are views onto a position or a range of the store.
+#
+#Each network gets a size between width_low and width_high and its nodes
+#are typed by TYPE_MIX. A node draws its degree and its vulnerability count
+#from ranges for its type, and the degrees are wired up as a configuration
+#model (shuffled stubs paired off, self loops and repeats dropped).
+#Neighbor lists, components and hazard propagation come from a csr
+#adjacency built once from the store's edge arrays.
+
+TYPES = ('server', 'switch', 'PC')
+TYPE_MIX = (0.10, 0.15, 0.75)
+DEGREE = ((2, 6), (4, 24), (1, 2))
+VULN_COUNT = ((2, 8), (0, 3), (0, 10))
+NUM_VULNS = 10
+BATCH = 64
+
 
 class node:
-    def __init__(self, name):
-        self.name = None
-        self.type = None
-        self.vulns = []
-        self.neighbors = []
+    def __init__(self, store, index):
+        self.store = store
+        self.index = index
+
+    @property
+    def net(self):
+        return self.store.net_of(self.index)
+
+    @property
+    def name(self):
+        n = self.net
+        return "%s-%d" % (n.name, self.index - n.start)
+
+    @property
+    def type(self):
+        return TYPES[self.store.types[self.index]]
+
+    @property
+    def vulns(self):
+        s = self.store
+        return s.vulns[s.vuln_off[self.index]:s.vuln_off[self.index + 1]]
+
+    @property
+    def neighbors(self):
+        #global node ids
+        return self.store.graph().neighbors(self.index)
 
 
 class net:
-    def __init__(self,name):
-        self.name = name
-        self.size = len(self.nodes)
-        self.nodes = []
-    
-    def gen_node(self, name):
-        new = node()
+    def __init__(self, store, index):
+        self.store = store
+        self.index = index
+        self.name = "net%d" % index
+        self.start = store.net_off[index]
+        self.size = store.net_off[index + 1] - self.start
+        self.edge_start = store.edge_off[index]
+        self.edge_end = store.edge_off[index + 1]
+
+    def __len__(self):
+        return self.size
+
+    @property
+    def nodes(self):
+        return [node(self.store, v) for v in range(self.start, self.start + self.size)]
+
+
+class NodeStore:
+    def __init__(self, cvss=None):
+        self.cvss = cvss if cvss is not None else array('B')
+        self.net_off = array('Q', [0])
+        self.edge_off = array('Q', [0])
+        self.types = array('B')
+        self.vuln_off = array('Q', [0])
+        self.vulns = array('H')
+        self.src = array('I')
+        self.dst = array('I')
+        self._graph = None
+
+    def __len__(self):
+        return len(self.types)
 
+    def nets(self):
+        return len(self.net_off) - 1
 
-def netGen(name, width_low, width_high):
-    pass
+    def net(self, i):
+        return net(self, i)
 
+    def node(self, v):
+        return node(self, v)
 
+    def net_of(self, v):
+        lo, hi = 0, self.nets()
+        while hi - lo > 1:
+            mid = (lo + hi) // 2
+            if self.net_off[mid] <= v:
+                lo = mid
+            else:
+                hi = mid
+        return net(self, lo)
 
+    def append(self, part):
+        #part: one network from gen_net, with node ids local to it
+        types, vuln_off, vulns, src, dst = part
+        base, vbase = len(self.types), len(self.vulns)
+        self.types.extend(types)
+        self.vuln_off.extend(vbase + o for o in vuln_off[1:])
+        self.vulns.extend(vulns)
+        self.src.extend(base + v for v in src)
+        self.dst.extend(base + v for v in dst)
+        self.net_off.append(len(self.types))
+        self.edge_off.append(len(self.src))
+        self._graph = None
 
-#Ask user for inputs
-print("""
+    def graph(self, workers=1):
+        if self._graph is None:
+            self._graph = csr.from_edges(len(self.types), self.src, self.dst, workers)
+        return self._graph
+
+    def hazard(self):
+        #summed CVSS of each node's vulnerabilities, as in rand_net.ipynb
+        cvss, vulns, off = self.cvss, self.vulns, self.vuln_off
+        return array('d', (sum(cvss[k] for k in vulns[off[v]:off[v + 1]])
+                           for v in range(len(self.types))))
+
+    def type_counts(self):
+        counts = [0] * len(TYPES)
+        for t in range(len(TYPES)):
+            counts[t] = self.types.count(t)
+        return counts
+
+
+def random_CVSS(seed=None, count=NUM_VULNS):
+    #vulnerability id -> CVSS score 1-10, like NetDBgen.random_CVSS
+    rng = random.Random(seed)
+    return array('B', (rng.randint(1, 10) for _ in range(count)))
+
+
+def gen_net(size, seed, num_vulns=NUM_VULNS):
+    rng = random.Random(seed)
+    types = array('B', rng.choices(range(len(TYPES)), TYPE_MIX, k=size))
+    vuln_off = array('Q', [0])
+    vulns = array('H')
+    stubs = array('I')
+    for v, t in enumerate(types):
+        lo, hi = VULN_COUNT[t]
+        vulns.extend(sorted(rng.sample(range(num_vulns), min(rng.randint(lo, hi), num_vulns))))
+        vuln_off.append(len(vulns))
+        lo, hi = DEGREE[t]
+        stubs.extend(array('I', [v]) * rng.randint(lo, hi))
+    rng.shuffle(stubs)
+    seen = set()
+    src, dst = array('I'), array('I')
+    for i in range(0, len(stubs) - 1, 2):
+        a, b = stubs[i], stubs[i + 1]
+        if a < b:
+            a, b = b, a
+        if a != b and (a, b) not in seen:
+            seen.add((a, b))
+            src.append(a)
+            dst.append(b)
+    return types, vuln_off, vulns, src, dst
+
+
+def _gen_batch(jobs, num_vulns):
+    return [gen_net(size, seed, num_vulns) for size, seed in jobs]
+
+
+def netGen(count, width_low, width_high, seed=None, workers=1, num_vulns=NUM_VULNS):
+    #network sizes and per-network seeds come from one master stream, so the
+    #store is the same for any number of workers
+    if seed is None:
+        seed = random.randrange(1 << 30)
+    rng = random.Random(seed)
+    store = NodeStore(random_CVSS(rng.randrange(1 << 30), num_vulns))
+    jobs = [(rng.randint(width_low, width_high), "%s-%d" % (seed, i)) for i in range(count)]
+    batches = [jobs[i:i + BATCH] for i in range(0, len(jobs), BATCH)]
+    if workers <= 1:
+        for b in batches:
+            for part in _gen_batch(b, num_vulns):
+                store.append(part)
+        return store
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        for batch in pool.map(_gen_batch, batches, [num_vulns] * len(batches)):
+            for part in batch:
+                store.append(part)
+    return store
+
+
+#Usage: python dbgenold.py (asks for the network counts and sizes)
+if __name__ == "__main__":
+    print("""
 -----NetDBgen-----
 By: MIDN Mier, Goohs, and Deist
 This program generates a Network database of nodes.
-There are 3 types of nodes: servers, switches, and 
+There are 3 types of nodes: servers, switches, and
 PCs.
 """)
-while 1:
-    length = input("Number of networks: ")
-    width_low = input("Smallest size of a single network (nodes): ")
-    width_high = input("Largest size of a single network (nodes): ")
-    if width_low >= width_high:
-        print("Invalid widths")
-    else:
-        break
-    
-
-for i in range(length):
-    pass
+    while 1:
+        length = int(input("Number of networks: "))
+        width_low = int(input("Smallest size of a single network (nodes): "))
+        width_high = int(input("Largest size of a single network (nodes): "))
+        if width_low > width_high or width_low < 1:
+            print("Invalid widths")
+        else:
+            break
+    workers = int(input("Worker processes: ") or 1)
+
+    start = time.perf_counter()
+    store = netGen(length, width_low, width_high, workers=workers)
+    print("%d networks, %d nodes, %d edges, %d vulnerabilities in %.3fs"
+          % (store.nets(), len(store), len(store.src), len(store.vulns), time.perf_counter() - start))
+    for name, count in zip(TYPES, store.type_counts()):
+        print("%-8s %d" % (name, count))
+
+    start = time.perf_counter()
+    g = store.graph(workers)
+    labels, components = g.components()
+    h = g.propagate(store.hazard())
+    worst = max(range(len(h)), key=h.__getitem__) if len(h) else None
+    print("%d components, propagated hazard peaks at %s (%.1f) in %.3fs"
+          % (components, store.node(worst).name if worst is not None else '-',
+             h[worst] if worst is not None else 0.0, time.perf_counter() - start))
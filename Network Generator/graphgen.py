@@ -0,0 +1,224 @@
+import math
+import random
+import sys
+import time
+from array import array
+from concurrent.futures import ProcessPoolExecutor
+
+import csr
+
+#Random network generators for the hazard and optimizer stages. They write
+#straight into an Edges list (two uint32 arrays) instead of building a
+#networkx Graph. to_csr() turns one into the csr adjacency the traversal
+#stages run on; to_networkx() is there for drawing small examples.
+
+
+class Edges:
+    def __init__(self, n, src=None, dst=None):
+        self.n = n
+        self.src = src if src is not None else array('I')
+        self.dst = dst if dst is not None else array('I')
+
+    def __len__(self):
+        return len(self.src)
+
+    def __iter__(self):
+        return zip(self.src, self.dst)
+
+    def extend(self, other):
+        self.src.extend(other.src)
+        self.dst.extend(other.dst)
+
+    def to_csr(self, workers=1):
+        return csr.from_edges(self.n, self.src, self.dst, workers)
+
+    def to_networkx(self):
+        import networkx as nx
+        g = nx.Graph()
+        g.add_nodes_from(range(self.n))
+        g.add_edges_from(zip(self.src, self.dst))
+        return g
+
+
+#Erdos-Renyi G(n, p) by geometric skip sampling (Batagelj and Brandes,
+#2005): instead of drawing a random number for each of the n(n-1)/2 pairs,
+#draw the gap to the next edge, so the cost is O(n + m). Rows are split into
+#blocks holding about the same number of pairs and each block runs in a
+#worker with its own RNG stream, seeded from (seed, block), so the graph
+#does not depend on the number of workers.
+
+
+BLOCKS = 64
+
+
+def _er_rows(n, p, v0, v1, seed):
+    rng = random.Random('%s-%d' % (seed, v0))
+    out = Edges(n)
+    src, dst = out.src, out.dst
+    if p >= 1:
+        for v in range(v0, v1):
+            src.extend([v] * v)
+            dst.extend(range(v))
+        return out
+    lq = math.log(1.0 - p)
+    v, w = max(v0, 1), -1
+    while v < v1:
+        w += 1 + int(math.log(1.0 - rng.random()) / lq)
+        while w >= v and v < v1:
+            w -= v
+            v += 1
+        if v < v1:
+            src.append(v)
+            dst.append(w)
+    return out
+
+
+def _row_blocks(n, blocks):
+    #row v has v pairs below it, so cut at equal shares of n^2 / 2
+    cuts = [0]
+    for b in range(1, blocks):
+        cuts.append(max(cuts[-1], int(n * math.sqrt(b / blocks))))
+    cuts.append(n)
+    return [(a, b) for a, b in zip(cuts, cuts[1:]) if a < b]
+
+
+def er(n, p, seed=None, workers=1, blocks=BLOCKS):
+    if seed is None:
+        seed = random.randrange(1 << 30)
+    if p <= 0 or n < 2:
+        return Edges(n)
+    ranges = _row_blocks(n, blocks)
+    out = Edges(n)
+    if workers <= 1:
+        for v0, v1 in ranges:
+            out.extend(_er_rows(n, p, v0, v1, seed))
+        return out
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        futures = [pool.submit(_er_rows, n, p, v0, v1, seed) for v0, v1 in ranges]
+        for fut in futures:
+            out.extend(fut.result())
+    return out
+
+
+#Barabasi-Albert preferential attachment. Every edge puts both endpoints in
+#one flat array, so a node appears in it once per unit of degree and a
+#uniform pick from the array is a degree-proportional pick, O(1) per edge.
+#The first new node links to all m seed nodes; each later node draws m
+#distinct targets. Growth is sequential, so this one has no workers.
+
+
+def ba(n, m, seed=None):
+    if m < 1 or n <= m:
+        return Edges(max(n, 0))
+    rng = random.Random(seed)
+    pick = rng.random
+    edges = (n - m) * m
+    src = array('I', bytes(4 * edges))
+    dst = array('I', bytes(4 * edges))
+    ends = array('I', bytes(8 * edges))
+    e = 0
+    for t in range(m):
+        src[e], dst[e] = m, t
+        ends[2 * e], ends[2 * e + 1] = m, t
+        e += 1
+    for v in range(m + 1, n):
+        size = 2 * e
+        targets = set()
+        while len(targets) < m:
+            targets.add(ends[int(pick() * size)])
+        for t in targets:
+            src[e], dst[e] = v, t
+            ends[2 * e], ends[2 * e + 1] = v, t
+            e += 1
+    return Edges(n, src, dst)
+
+
+#Stochastic block model: nodes are split into consecutive blocks (a
+#department, a subnet) and a pair in blocks r and s is an edge with
+#probability probs[r][s]. Each block pair is one skip-sampling job with its
+#own RNG stream: the triangle inside a block as in er(), and the r x s
+#rectangle between two blocks as a single run of pair numbers.
+
+
+def _gaps(p, rng):
+    if p >= 1:
+        return lambda: 0
+    lq = math.log(1.0 - p)
+    return lambda: int(math.log(1.0 - rng.random()) / lq)
+
+
+def _sbm_pair(r, s, off_r, k_r, off_s, k_s, p, seed):
+    gap = _gaps(p, random.Random('%s-%d-%d' % (seed, r, s)))
+    out = Edges(0)
+    src, dst = out.src, out.dst
+    if r == s:
+        v, w = 1, -1
+        while v < k_r:
+            w += 1 + gap()
+            while w >= v and v < k_r:
+                w -= v
+                v += 1
+            if v < k_r:
+                src.append(off_r + v)
+                dst.append(off_r + w)
+    else:
+        #the later block is always the source, so src > dst as in er()
+        i, pairs = -1, k_r * k_s
+        while True:
+            i += 1 + gap()
+            if i >= pairs:
+                break
+            src.append(off_s + i // k_r)
+            dst.append(off_r + i % k_r)
+    return out
+
+
+def sbm(sizes, probs, seed=None, workers=1):
+    #returns (edges, labels) where labels[v] is the block of node v
+    if seed is None:
+        seed = random.randrange(1 << 30)
+    offsets = [0]
+    labels = array('I')
+    for b, k in enumerate(sizes):
+        offsets.append(offsets[-1] + k)
+        labels.extend(array('I', [b]) * k)
+    jobs = [(r, s, offsets[r], sizes[r], offsets[s], sizes[s], probs[r][s], seed)
+            for s in range(len(sizes)) for r in range(s + 1)
+            if probs[r][s] > 0 and sizes[r] and sizes[s]]
+    out = Edges(offsets[-1])
+    if workers <= 1:
+        for job in jobs:
+            out.extend(_sbm_pair(*job))
+        return out, labels
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        for part in pool.map(_sbm_pair, *zip(*jobs)):
+            out.extend(part)
+    return out, labels
+
+
+#Usage: python graphgen.py er n p [seed] [workers]
+#       python graphgen.py ba n m [seed]
+#       python graphgen.py sbm size,size,... p_in p_out [seed] [workers]
+if __name__ == "__main__":
+    kind = sys.argv[1]
+    start = time.perf_counter()
+    if kind == 'er':
+        n, p = int(sys.argv[2]), float(sys.argv[3])
+        seed = int(sys.argv[4]) if len(sys.argv) > 4 else None
+        workers = int(sys.argv[5]) if len(sys.argv) > 5 else 1
+        g = er(n, p, seed, workers)
+    elif kind == 'ba':
+        n, m = int(sys.argv[2]), int(sys.argv[3])
+        seed = int(sys.argv[4]) if len(sys.argv) > 4 else None
+        g = ba(n, m, seed)
+    elif kind == 'sbm':
+        sizes = [int(k) for k in sys.argv[2].split(',')]
+        p_in, p_out = float(sys.argv[3]), float(sys.argv[4])
+        seed = int(sys.argv[5]) if len(sys.argv) > 5 else None
+        workers = int(sys.argv[6]) if len(sys.argv) > 6 else 1
+        blocks = range(len(sizes))
+        probs = [[p_in if r == s else p_out for s in blocks] for r in blocks]
+        g, labels = sbm(sizes, probs, seed, workers)
+    else:
+        sys.exit("unknown generator " + kind)
+    print("%s: %d nodes, %d edges in %.3fs" % (kind, g.n, len(g), time.perf_counter() - start))
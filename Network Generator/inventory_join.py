@@ -0,0 +1,199 @@
+import multiprocessing
+import os
+import struct
+import sys
+import time
+from array import array
+from concurrent.futures import ProcessPoolExecutor
+
+from cpe_config import Inventory, compile_item
+from nvd_stream import iter_feeds
+
+#Joins real machine inventories against the NVD, replacing the invented
+#"vuln:score" lists of NetDBgen.get_vuln.
+#
+#Inventory file: one machine per line, machine name then its installed
+#software as cpe23Uri strings, tab separated.
+#
+#The join is a hash join on (vendor, product): every vulnerable cpe_match
+#of every CVE is put in a table keyed on its product, a machine's software
+#probes that table for candidate CVEs, and each candidate is confirmed by
+#the compiled configuration program (cpe_config), which applies the
+#version ranges and AND/platform conditions. Machines with the same
+#software list share one result: the distinct lists are found first, over
+#the whole input, and only those are joined. Chunks of distinct lists run in
+#worker processes that inherit the table from the parent, so the pool is
+#always started with fork; where fork does not exist the join runs serially.
+#
+#Output is CSR: offsets[m]..offsets[m + 1] index the CVE rows of machine m
+#in a single rows array.
+
+MAGIC = b'NVDJ'
+HEADER = struct.Struct('<4sIQQ')    #magic, version, machines, entries
+CHUNK = 4096       #smallest batch of machines sent to a worker
+
+_ids = []
+_scores = []
+_configs = []
+_by_product = {}
+
+
+def _score(item):
+    #CVSS v3 base score, else v2, else None
+    impact = item.get('impact', {})
+    m3 = impact.get('baseMetricV3')
+    if m3:
+        return m3['cvssV3']['baseScore']
+    m2 = impact.get('baseMetricV2')
+    return m2['cvssV2']['baseScore'] if m2 else None
+
+
+def load_cves(paths):
+    #one row per CVE ID: the record with the newest lastModifiedDate wins,
+    #ties go to the later feed, as in nvd_ingest
+    global _ids, _scores, _configs, _by_product
+    best = {}
+    for item in iter_feeds(paths):
+        cve_id = item['cve']['CVE_data_meta']['ID']
+        modified = item.get('lastModifiedDate') or ''
+        old = best.get(cve_id)
+        if old is None or modified >= old[0]:
+            best[cve_id] = (modified, _score(item), compile_item(item))
+    _ids, _scores, _configs, _by_product = [], [], [], {}
+    for row, (cve_id, (_, score, cfg)) in enumerate(best.items()):
+        _ids.append(cve_id)
+        _scores.append(score)
+        _configs.append(cfg)
+        for leaf, vuln in zip(cfg.leaves, cfg.vulnerable):
+            if vuln:
+                rows = _by_product.setdefault(leaf[0], array('I'))
+                if not rows or rows[-1] != row:
+                    rows.append(row)
+
+
+def read_inventories(path):
+    names, inventories = [], []
+    with open(path) as f:
+        for line in f:
+            parts = line.rstrip('\n').split('\t')
+            if parts[0]:
+                names.append(parts[0])
+                inventories.append(tuple(p for p in parts[1:] if p))
+    return names, inventories
+
+
+def join_one(software):
+    inv = Inventory(software)
+    candidates = set()
+    for key in inv.products:
+        rows = _by_product.get(key)
+        if rows:
+            candidates.update(rows)
+    return [row for row in sorted(candidates) if _configs[row].applies(inv)]
+
+
+def join_chunk(inventories):
+    #-> (per inventory match counts, concatenated rows) as compact arrays
+    counts = array('I')
+    rows = array('I')
+    for software in inventories:
+        hit = join_one(software)
+        counts.append(len(hit))
+        rows.extend(hit)
+    return counts, rows
+
+
+def _fork_pool(workers):
+    try:
+        ctx = multiprocessing.get_context('fork')
+    except ValueError:
+        return None
+    return ProcessPoolExecutor(max_workers=workers, mp_context=ctx)
+
+
+def join(inventories, workers=None):
+    workers = workers or os.cpu_count() or 1
+    #machine -> index of its software list among the distinct ones
+    seen = {}
+    distinct = []
+    which = array('I')
+    for software in inventories:
+        key = frozenset(software)
+        d = seen.get(key)
+        if d is None:
+            d = seen[key] = len(distinct)
+            distinct.append(software)
+        which.append(d)
+    size = max(CHUNK, -(-len(distinct) // (workers * 4)))
+    chunks = [distinct[i:i + size] for i in range(0, len(distinct), size)]
+    pool = None
+    if workers > 1 and len(chunks) > 1:
+        pool = _fork_pool(workers)
+    results = pool.map(join_chunk, chunks) if pool is not None else map(join_chunk, chunks)
+    starts = array('Q', [0])
+    found = array('I')
+    for counts, chunk_rows in results:
+        end = starts[-1]
+        for c in counts:
+            end += c
+            starts.append(end)
+        found.extend(chunk_rows)
+    if pool is not None:
+        pool.shutdown()
+    offsets = array('Q', [0])
+    rows = array('I')
+    for d in which:
+        rows.extend(found[starts[d]:starts[d + 1]])
+        offsets.append(len(rows))
+    return offsets, rows
+
+
+def write_csr(path, offsets, rows):
+    with open(path, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, 1, len(offsets) - 1, len(rows)))
+        offsets.tofile(f)
+        rows.tofile(f)
+
+
+def read_csr(path):
+    with open(path, 'rb') as f:
+        magic, _, machines, entries = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC:
+            raise ValueError("%s is not a join result" % path)
+        offsets = array('Q')
+        offsets.fromfile(f, machines + 1)
+        rows = array('I')
+        rows.fromfile(f, entries)
+    return offsets, rows
+
+
+def write_scenario(path, names, offsets, rows):
+    #same (machine, ['vuln:score', ...]) lines NetDBgen.py writes; CVEs
+    #without any CVSS score are left out
+    with open(path, 'w') as out:
+        for m, name in enumerate(names):
+            vulns = ['%s:%s' % (_ids[r], _scores[r]) for r in rows[offsets[m]:offsets[m + 1]]
+                     if _scores[r] is not None]
+            out.write(str((name, vulns)) + '\n')
+
+
+#Usage: python inventory_join.py inventory.tsv out.csr feed.json [feed.json ...]
+#       add --scenario out.txt to also write NetDBgen style lines
+if __name__ == "__main__":
+    args = sys.argv[1:]
+    scenario = None
+    if '--scenario' in args:
+        i = args.index('--scenario')
+        scenario = args[i + 1]
+        del args[i:i + 2]
+    start = time.perf_counter()
+    load_cves(args[2:])
+    names, inventories = read_inventories(args[0])
+    loaded = time.perf_counter()
+    offsets, rows = join(inventories)
+    done = time.perf_counter()
+    write_csr(args[1], offsets, rows)
+    if scenario:
+        write_scenario(scenario, names, offsets, rows)
+    print("%d CVEs, %d machines loaded in %.2fs; join %.2fs, %d matches"
+          % (len(_ids), len(names), loaded - start, done - loaded, len(rows)))
@@ -1,9 +1,99 @@
+import argparse
+import io
 import json
 import sys
 
-with open(sys.argv[1]) as f:
-    data = json.load(f)
-    data = data['CVE_Items']
-    for i in range(len(data)):
-        print("Vulnerability: "+str(i))
-        print(data[i])
+from nvd_stream import iter_items
+
+#Dumps a feed. Without --format the old per-item repr dump is kept;
+#--format ndjson writes one JSON object per line holding only the --fields
+#asked for, and --format bin writes fixed 32 byte nvd_record rows, so the
+#generator and optimizer can read the output back directly.
+
+
+def _v3(item):
+    return item.get('impact', {}).get('baseMetricV3', {}).get('cvssV3', {})
+
+
+def _v2(item):
+    return item.get('impact', {}).get('baseMetricV2', {}).get('cvssV2', {})
+
+
+def _cwe(item):
+    for pt in item['cve']['problemtype']['problemtype_data']:
+        for desc in pt['description']:
+            return desc['value']
+    return None
+
+
+FIELDS = {
+    'id': lambda item: item['cve']['CVE_data_meta']['ID'],
+    'v3': lambda item: _v3(item).get('baseScore'),
+    'vector': lambda item: _v3(item).get('vectorString'),
+    'severity': lambda item: _v3(item).get('baseSeverity'),
+    'v2': lambda item: _v2(item).get('baseScore'),
+    'v2vector': lambda item: _v2(item).get('vectorString'),
+    'cwe': _cwe,
+    'published': lambda item: item.get('publishedDate'),
+    'modified': lambda item: item.get('lastModifiedDate'),
+    'description': lambda item: item['cve']['description']['description_data'][0]['value'],
+}
+
+BUFFER_SIZE = 1 << 20
+BATCH = 1024
+
+
+def write_ndjson(items, fields, out):
+    getters = [(name, FIELDS[name]) for name in fields]
+    encode = json.JSONEncoder(separators=(',', ':')).encode
+    batch = []
+    for item in items:
+        batch.append(encode({name: get(item) for name, get in getters}))
+        if len(batch) == BATCH:
+            out.write(('\n'.join(batch) + '\n').encode('utf-8'))
+            batch = []
+    if batch:
+        out.write(('\n'.join(batch) + '\n').encode('utf-8'))
+
+
+def write_bin(items, out):
+    from nvd_record import pack
+    batch = bytearray()
+    for item in items:
+        batch += pack(item)
+        if len(batch) >= BUFFER_SIZE:
+            out.write(batch)
+            batch = bytearray()
+    out.write(batch)
+
+
+def write_repr(items, out):
+    for i, item in enumerate(items):
+        out.write(("Vulnerability: " + str(i) + "\n" + str(item) + "\n").encode('utf-8'))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument('feed')
+    parser.add_argument('--format', choices=('repr', 'ndjson', 'bin'), default='repr')
+    parser.add_argument('--fields', default='id,v3,vector,cwe',
+                        help='comma separated, from: ' + ','.join(FIELDS))
+    parser.add_argument('-o', '--output', help='file to write instead of stdout')
+    args = parser.parse_args()
+
+    fields = args.fields.split(',')
+    for name in fields:
+        if name not in FIELDS:
+            parser.error("unknown field " + name)
+
+    sys.stdout.flush()
+    raw = open(args.output, 'wb') if args.output else open(sys.stdout.fileno(), 'wb', closefd=False)
+    with io.BufferedWriter(raw, BUFFER_SIZE) as out:
+        #items are decoded one at a time so large yearly feeds do not need to fit in memory
+        items = iter_items(args.feed)
+        if args.format == 'ndjson':
+            write_ndjson(items, fields, out)
+        elif args.format == 'bin':
+            write_bin(items, out)
+        else:
+            write_repr(items, out)
@@ -0,0 +1,126 @@
+import os
+import sys
+import time
+from concurrent.futures import ProcessPoolExecutor
+
+import nvd_stream
+
+#Front end for NVD 2.0 API responses saved as page files (vulnerabilities[],
+#metrics.cvssMetricV31, ...). Every 2.0 "cve" object is rewritten into the
+#1.1 CVE_Item layout, so the cache, record, store, CPE and search modules
+#take either schema unchanged. nvd_stream applies this to any file or
+#directory it is given; iter_items() here parses a directory of pages in
+#parallel, one page per worker, and pages come back in file name order.
+
+PAGE_SUFFIXES = ('.json', '.json.gz', '.zip')
+
+
+def _metric(metrics, *names):
+    #prefer the NVD "Primary" entry of the newest version present
+    for name in names:
+        entries = metrics.get(name) or []
+        for entry in entries:
+            if entry.get('type') == 'Primary':
+                return entry
+        if entries:
+            return entries[0]
+    return None
+
+
+def _time(s):
+    #2020-08-26T19:15:12.117 -> 2020-08-26T19:15Z
+    return s[:16] + 'Z' if s else s
+
+
+def _node(node):
+    matches = []
+    for m in node.get('cpeMatch', ()):
+        out = {'vulnerable': m.get('vulnerable', True), 'cpe23Uri': m['criteria']}
+        for key in ('versionStartIncluding', 'versionStartExcluding',
+                    'versionEndIncluding', 'versionEndExcluding'):
+            if key in m:
+                out[key] = m[key]
+        matches.append(out)
+    out = {'operator': node.get('operator', 'OR'), 'cpe_match': matches}
+    if node.get('negate'):
+        out['negate'] = True
+    return out
+
+
+def normalize(cve):
+    #one 2.0 "cve" object -> 1.1 CVE_Item
+    impact = {}
+    m3 = _metric(cve.get('metrics', {}), 'cvssMetricV31', 'cvssMetricV30')
+    if m3:
+        impact['baseMetricV3'] = {
+            'cvssV3': m3['cvssData'],
+            'exploitabilityScore': m3.get('exploitabilityScore'),
+            'impactScore': m3.get('impactScore'),
+        }
+    m2 = _metric(cve.get('metrics', {}), 'cvssMetricV2')
+    if m2:
+        impact['baseMetricV2'] = {
+            'cvssV2': m2['cvssData'],
+            'severity': m2.get('baseSeverity'),
+            'exploitabilityScore': m2.get('exploitabilityScore'),
+            'impactScore': m2.get('impactScore'),
+        }
+
+    nodes = []
+    for config in cve.get('configurations', ()):
+        converted = [_node(n) for n in config.get('nodes', ())]
+        if config.get('operator') == 'AND':
+            nodes.append({'operator': 'AND', 'children': converted, 'cpe_match': []})
+        else:
+            nodes.extend(converted)
+
+    return {
+        'cve': {
+            'data_type': 'CVE',
+            'CVE_data_meta': {'ID': cve['id'], 'ASSIGNER': cve.get('sourceIdentifier')},
+            'problemtype': {'problemtype_data': [
+                {'description': w.get('description', [])} for w in cve.get('weaknesses', ())
+            ] or [{'description': []}]},
+            'references': {'reference_data': [
+                {'url': r['url'], 'name': r['url'], 'refsource': r.get('source'),
+                 'tags': r.get('tags', [])} for r in cve.get('references', ())
+            ]},
+            'description': {'description_data': [
+                {'lang': d['lang'], 'value': d['value']} for d in cve.get('descriptions', ())
+            ]},
+        },
+        'configurations': {'CVE_data_version': '4.0', 'nodes': nodes},
+        'impact': impact,
+        'publishedDate': _time(cve.get('published')),
+        'lastModifiedDate': _time(cve.get('lastModified')),
+    }
+
+
+def read_page(path):
+    return list(nvd_stream.iter_items(path))
+
+
+def page_files(path):
+    if os.path.isdir(path):
+        return [os.path.join(path, n) for n in sorted(os.listdir(path))
+                if n.endswith(PAGE_SUFFIXES)]
+    return [path]
+
+
+def iter_items(path, workers=None):
+    #normalized items of one page file or of every page in a directory
+    files = page_files(path)
+    if len(files) == 1:
+        yield from read_page(files[0])
+        return
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        for items in pool.map(read_page, files):
+            yield from items
+
+
+#Usage: python nvd2.py page_dir_or_file
+if __name__ == "__main__":
+    start = time.perf_counter()
+    count = sum(1 for _ in iter_items(sys.argv[1]))
+    print("%d CVEs from %d pages in %.3fs"
+          % (count, len(page_files(sys.argv[1])), time.perf_counter() - start))
@@ -0,0 +1,429 @@
+import bisect
+import calendar
+import mmap
+import os
+import struct
+import sys
+import time
+from array import array
+
+import cvss
+import nvd_mph
+from nvd_stream import iter_items, source_stat
+from string_pool import POOL, pool_path
+
+#Columnar binary cache of parsed CVE_Items. The file is a header, a column
+#directory and then one packed array per column, so a later run can mmap it
+#and read rows without parsing any JSON. The header records the format
+#version and the size and mtime of the source feed; if any of these do not
+#match, load_cache() rebuilds the file.
+#
+#Scores are stored as tenths in a uint16 (NO_SCORE when missing), times as
+#seconds since the epoch and the CWE as its number (0 when there is none).
+#mph_seed/mph_slot hold a minimal perfect hash (nvd_mph) from the encoded
+#CVE ID to its row, so find() costs two hashes and a key check. When an ID
+#repeats (several feeds concatenated, a page directory) the later row wins:
+#the earlier ones stay in place, so rows keep their feed positions, but are
+#listed in shadowed and left out of find(), query_time() and with_refs().
+#refs holds one REF_* bit per tag seen in cve.references.reference_data, so
+#the optimizer can drop CVEs with no patch and weight ones with a known
+#exploit without going back to the JSON.
+#
+#For each of published and modified there is a time sorted permutation of
+#the rows (pub_order, mod_order) cut into blocks of TIME_BLOCK, with the min and
+#max time and the highest v3 score of every block. query_time() binary
+#searches the blocks and skips any whose time range or best score cannot
+#match, so "modified in the last N days with v3 >= 7" reads a few blocks.
+#
+#CWE ids and reference sources are interned in string_pool.POOL while
+#parsing and cwe_h / src_h hold their handles; the reference sources of row
+#i are src_h[src_off[i]:src_off[i + 1]]. Writing the cache persists the pool
+#to the shared strings.pool next to it and pool_ref records its token and
+#size; a cache whose pool no longer matches is rebuilt by load_cache().
+
+MAGIC = b'NVDC'
+FORMAT_VERSION = 8
+
+HEADER = struct.Struct('<4sIIQqI')      #magic, version, rows, src size, src mtime, columns
+COLUMN = struct.Struct('<16scxxxxxxxQQ')  #name (16 bytes max), typecode, offset, bytes
+
+NO_SCORE = cvss.NO_SCORE
+CWE_OTHER = 0xFFFFFFFE
+CWE_NOINFO = 0xFFFFFFFD
+NO_HANDLE = 0xFFFFFFFF
+
+COLUMNS = [
+    ('id_off', 'I'),
+    ('id_str', 'B'),
+    ('v3_base', 'H'),
+    ('v2_base', 'H'),
+    ('v3_expl', 'H'),
+    ('v3_impact', 'H'),
+    ('v2_expl', 'H'),
+    ('v2_impact', 'H'),
+    ('v3_vector', 'I'),
+    ('v2_vector', 'I'),
+    ('published', 'q'),
+    ('modified', 'q'),
+    ('cwe', 'I'),
+    ('refs', 'H'),
+    ('cwe_h', 'I'),
+    ('src_off', 'I'),
+    ('src_h', 'I'),
+    ('mph_seed', 'I'),
+    ('mph_slot', 'I'),
+    ('shadowed', 'I'),
+    ('pool_ref', 'Q'),
+]
+TIME_FIELDS = {'published': 'pub', 'modified': 'mod'}
+for _p in TIME_FIELDS.values():
+    COLUMNS += [(_p + '_order', 'I'), (_p + '_blk_min', 'q'),
+                (_p + '_blk_max', 'q'), (_p + '_blk_v3', 'H')]
+TIME_BLOCK = 256
+
+ID_BASE_YEAR = 1990
+
+REF_PATCH = 1 << 0
+REF_VENDOR_ADVISORY = 1 << 1
+REF_EXPLOIT = 1 << 2
+REF_MITIGATION = 1 << 3
+REF_THIRD_PARTY_ADVISORY = 1 << 4
+REF_RELEASE_NOTES = 1 << 5
+REF_ISSUE_TRACKING = 1 << 6
+REF_VDB_ENTRY = 1 << 7
+REF_US_GOVERNMENT = 1 << 8
+REF_TECHNICAL_DESCRIPTION = 1 << 9
+REF_BROKEN_LINK = 1 << 10
+
+REF_TAGS = {
+    'Patch': REF_PATCH,
+    'Vendor Advisory': REF_VENDOR_ADVISORY,
+    'Exploit': REF_EXPLOIT,
+    'Mitigation': REF_MITIGATION,
+    'Third Party Advisory': REF_THIRD_PARTY_ADVISORY,
+    'Release Notes': REF_RELEASE_NOTES,
+    'Issue Tracking': REF_ISSUE_TRACKING,
+    'VDB Entry': REF_VDB_ENTRY,
+    'US Government Resource': REF_US_GOVERNMENT,
+    'Technical Description': REF_TECHNICAL_DESCRIPTION,
+    'Broken Link': REF_BROKEN_LINK,
+}
+
+
+def encode_id(cve_id):
+    #CVE-YYYY-N -> (YYYY - 1990) << 24 | N
+    _, year, num = cve_id.split('-', 2)
+    return (int(year) - ID_BASE_YEAR) << 24 | int(num)
+
+
+def decode_id(code):
+    return 'CVE-%d-%04d' % ((code >> 24) + ID_BASE_YEAR, code & 0xFFFFFF)
+
+
+def parse_time(s):
+    #NVD times look like 2020-08-26T19:15Z
+    if not s:
+        return 0
+    return calendar.timegm((int(s[0:4]), int(s[5:7]), int(s[8:10]),
+                            int(s[11:13]), int(s[14:16]), 0, 0, 0, 0))
+
+
+def score(value):
+    return NO_SCORE if value is None else int(round(value * 10))
+
+
+def cwe_number(value):
+    if value.startswith('CWE-'):
+        return int(value[4:])
+    if value == 'NVD-CWE-Other':
+        return CWE_OTHER
+    if value == 'NVD-CWE-noinfo':
+        return CWE_NOINFO
+    return 0
+
+
+def ref_flags(item):
+    flags = 0
+    for ref in item['cve'].get('references', {}).get('reference_data', ()):
+        for tag in ref.get('tags', ()):
+            flags |= REF_TAGS.get(tag, 0)
+    return flags
+
+
+def ref_sources(item):
+    #distinct reference sources of an item, as pool handles
+    out = []
+    for ref in item['cve'].get('references', {}).get('reference_data', ()):
+        if ref.get('refsource'):
+            h = POOL.intern(ref['refsource'])
+            if h not in out:
+                out.append(h)
+    return out
+
+
+def first_cwe(item):
+    #(CWE number, pool handle of its name)
+    for pt in item['cve']['problemtype']['problemtype_data']:
+        for desc in pt['description']:
+            return cwe_number(desc['value']), POOL.intern(desc['value'])
+    return 0, NO_HANDLE
+
+
+def new_columns():
+    return {name: array(code) for name, code in COLUMNS}
+
+
+def add_item(cols, item):
+    ids = cols['id_str']
+    if not cols['id_off']:
+        cols['id_off'].append(0)
+    ids.frombytes(item['cve']['CVE_data_meta']['ID'].encode('ascii'))
+    cols['id_off'].append(len(ids))
+
+    impact = item.get('impact', {})
+    m3 = impact.get('baseMetricV3')
+    m2 = impact.get('baseMetricV2')
+    if m3:
+        cols['v3_base'].append(score(m3['cvssV3']['baseScore']))
+        cols['v3_expl'].append(score(m3.get('exploitabilityScore')))
+        cols['v3_impact'].append(score(m3.get('impactScore')))
+        cols['v3_vector'].append(cvss.pack_v3(m3['cvssV3']['vectorString']))
+    else:
+        cols['v3_base'].append(NO_SCORE)
+        cols['v3_expl'].append(NO_SCORE)
+        cols['v3_impact'].append(NO_SCORE)
+        cols['v3_vector'].append(0)
+    if m2:
+        cols['v2_base'].append(score(m2['cvssV2']['baseScore']))
+        cols['v2_expl'].append(score(m2.get('exploitabilityScore')))
+        cols['v2_impact'].append(score(m2.get('impactScore')))
+        cols['v2_vector'].append(cvss.pack_v2(m2['cvssV2']['vectorString']))
+    else:
+        cols['v2_base'].append(NO_SCORE)
+        cols['v2_expl'].append(NO_SCORE)
+        cols['v2_impact'].append(NO_SCORE)
+        cols['v2_vector'].append(0)
+
+    cols['published'].append(parse_time(item.get('publishedDate')))
+    cols['modified'].append(parse_time(item.get('lastModifiedDate')))
+    cwe, cwe_h = first_cwe(item)
+    cols['cwe'].append(cwe)
+    cols['cwe_h'].append(cwe_h)
+    cols['refs'].append(ref_flags(item))
+    if not cols['src_off']:
+        cols['src_off'].append(0)
+    cols['src_h'].extend(ref_sources(item))
+    cols['src_off'].append(len(cols['src_h']))
+
+
+def write_cache(path, items, src_size=0, src_mtime=0):
+    POOL.prepare(path)
+    cols = new_columns()
+    for item in items:
+        add_item(cols, item)
+    for name in ('id_off', 'src_off'):
+        if not cols[name]:
+            cols[name].append(0)
+    rows = len(cols['id_off']) - 1
+
+    #later rows win when a CVE ID repeats (concatenated feeds)
+    last = {}
+    id_off, id_str = cols['id_off'], cols['id_str']
+    for i in range(rows):
+        last[encode_id(id_str[id_off[i]:id_off[i + 1]].tobytes().decode('ascii'))] = i
+    cols['mph_seed'], cols['mph_slot'] = nvd_mph.build(list(last), list(last.values()))
+    live = set(last.values())
+    cols['shadowed'] = array('I', (i for i in range(rows) if i not in live))
+
+    token = POOL.persist(pool_path(path))
+    cols['pool_ref'] = array('Q', [token, len(POOL)])
+
+    v3 = cols['v3_base']
+    for field, p in TIME_FIELDS.items():
+        times = cols[field]
+        order = array('I', sorted(live, key=lambda r: (times[r], r)))
+        cols[p + '_order'] = order
+        for b in range(0, len(order), TIME_BLOCK):
+            block = order[b:b + TIME_BLOCK]
+            cols[p + '_blk_min'].append(times[block[0]])
+            cols[p + '_blk_max'].append(times[block[-1]])
+            cols[p + '_blk_v3'].append(max(v3[r] if v3[r] != NO_SCORE else 0
+                                               for r in block))
+
+    #lay the columns out one after another, 8 byte aligned
+    offset = HEADER.size + COLUMN.size * len(COLUMNS)
+    directory = []
+    for name, code in COLUMNS:
+        offset = (offset + 7) & ~7
+        nbytes = len(cols[name]) * cols[name].itemsize
+        directory.append((name, code, offset, nbytes))
+        offset += nbytes
+
+    tmp = path + '.tmp'
+    with open(tmp, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, FORMAT_VERSION, rows, src_size, src_mtime,
+                            len(COLUMNS)))
+        for name, code, off, nbytes in directory:
+            f.write(COLUMN.pack(name.encode(), code.encode(), off, nbytes))
+        for name, code, off, nbytes in directory:
+            f.write(b'\0' * (off - f.tell()))
+            cols[name].tofile(f)
+    #readers never see a half written cache
+    os.replace(tmp, path)
+    return rows
+
+
+class Cache:
+    def __init__(self, path):
+        self.path = path
+        with open(path, 'rb') as f:
+            self._mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, self.version, self.rows, self.src_size, self.src_mtime, ncols = \
+            HEADER.unpack_from(self._mm, 0)
+        if magic != MAGIC:
+            self._mm.close()
+            raise ValueError("%s is not a CVE cache" % path)
+        self._buf = memoryview(self._mm)
+        self.cols = {}
+        for i in range(ncols):
+            name, code, off, nbytes = COLUMN.unpack_from(
+                self._mm, HEADER.size + i * COLUMN.size)
+            name = name.rstrip(b'\0').decode()
+            self.cols[name] = self._buf[off:off + nbytes].cast(code.decode())
+        self._pool_ok = False
+
+    def __len__(self):
+        return self.rows
+
+    def __getattr__(self, name):
+        cols = self.__dict__.get('cols')
+        if cols is not None and name in cols:
+            return cols[name]
+        raise AttributeError(name)
+
+    def id(self, i):
+        return bytes(self.id_str[self.id_off[i]:self.id_off[i + 1]]).decode('ascii')
+
+    def find(self, cve_id):
+        #row of a CVE ID, or -1
+        try:
+            row = nvd_mph.lookup(self.mph_seed, self.mph_slot, encode_id(cve_id))
+        except ValueError:
+            return -1
+        if row < 0 or row >= self.rows or self.id(row) != cve_id:
+            return -1
+        return row
+
+    def query_time(self, field, start, end, min_v3=None):
+        #rows with start <= field <= end (epoch seconds), optionally only
+        #those with a v3 base score of at least min_v3, in time order
+        p = TIME_FIELDS[field]
+        order = self.cols[p + '_order']
+        bmin = self.cols[p + '_blk_min']
+        bmax = self.cols[p + '_blk_max']
+        bv3 = self.cols[p + '_blk_v3']
+        times = self.cols[field]
+        v3 = self.v3_base
+        floor = None if min_v3 is None else score(min_v3)
+        out = []
+        b = bisect.bisect_left(bmax, start)
+        while b < len(bmin) and bmin[b] <= end:
+            if floor is None or bv3[b] >= floor:
+                for r in order[b * TIME_BLOCK:(b + 1) * TIME_BLOCK]:
+                    if start <= times[r] <= end and (
+                            floor is None or floor <= v3[r] != NO_SCORE):
+                        out.append(r)
+            b += 1
+        return out
+
+    def check_pool(self):
+        #ValueError unless the handles of this file are valid in POOL;
+        #columns without handles can be read either way
+        if not self._pool_ok:
+            POOL.check(self.path, *self.pool_ref)
+            self._pool_ok = True
+
+    def cwe_name(self, i):
+        h = self.cwe_handle(i)
+        return None if h == NO_HANDLE else POOL[h]
+
+    def cwe_handle(self, i):
+        #handle of row i's first CWE in string_pool.POOL, or NO_HANDLE
+        self.check_pool()
+        return self.cwe_h[i]
+
+    def ref_sources(self, i):
+        self.check_pool()
+        return [POOL[h] for h in self.src_h[self.src_off[i]:self.src_off[i + 1]]]
+
+    def with_refs(self, flags):
+        #rows whose references carry all of the given REF_* bits
+        skip = set(self.shadowed)
+        return [i for i, f in enumerate(self.refs) if f & flags == flags and i not in skip]
+
+    def row(self, i):
+        out = {'id': self.id(i)}
+        for name, col in self.cols.items():
+            if not (name.startswith(('id_', 'mph_', 'pool_', 'src_')) or '_blk_' in name
+                    or name.endswith('_order') or name in ('cwe_h', 'shadowed')):
+                out[name] = col[i]
+        return out
+
+    def close(self):
+        for col in self.cols.values():
+            col.release()
+        self.cols = {}
+        self._buf.release()
+        self._mm.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def _fresh(cache_path, src_size, src_mtime):
+    try:
+        with open(cache_path, 'rb') as f:
+            head = f.read(HEADER.size)
+        magic, version, _, size, mtime, _ = HEADER.unpack(head)
+    except (OSError, struct.error):
+        return False
+    return (magic == MAGIC and version == FORMAT_VERSION
+            and size == src_size and mtime == src_mtime)
+
+
+def load_cache(feed_path, cache_path=None):
+    if cache_path is None:
+        cache_path = feed_path + '.cache'
+    size, mtime = source_stat(feed_path)
+    if _fresh(cache_path, size, mtime):
+        cache = Cache(cache_path)
+        try:
+            cache.check_pool()
+            return cache
+        except ValueError:
+            cache.close()
+    write_cache(cache_path, iter_items(feed_path), size, mtime)
+    return Cache(cache_path)
+
+
+#Usage: python nvd_cache.py feed.json [days [min_v3 [published|modified]]]
+#with days, lists CVEs published (or modified) in the last N days
+if __name__ == "__main__":
+    start = time.perf_counter()
+    cache = load_cache(sys.argv[1])
+    print("%d CVEs from %s in %.3fs" % (len(cache), cache.path,
+                                        time.perf_counter() - start))
+    if len(sys.argv) > 2:
+        now = int(time.time())
+        min_v3 = float(sys.argv[3]) if len(sys.argv) > 3 else None
+        field = sys.argv[4] if len(sys.argv) > 4 else 'published'
+        start = time.perf_counter()
+        rows = cache.query_time(field, now - int(float(sys.argv[2]) * 86400), now, min_v3)
+        secs = time.perf_counter() - start
+        for r in rows:
+            print(cache.id(r))
+        print("%d matches in %.1f us" % (len(rows), secs * 1e6))
+    cache.close()
@@ -0,0 +1,67 @@
+import os
+import sys
+import time
+from concurrent.futures import ProcessPoolExecutor, as_completed
+
+import nvd2
+from nvd_stream import iter_items
+from nvd_store import Store, encode_item, id_key
+
+#Parallel ingest of many NVD feeds (the yearly files plus recent and
+#modified) into one nvd_store.Store. Each feed is parsed in its own worker
+#process. Feeds are handed out largest first from the pool's shared queue,
+#so an idle worker always takes the next pending feed and small feeds fill
+#in behind the big years.
+#
+#The merge does not depend on which worker finishes first: for every CVE ID
+#the record with the newest lastModifiedDate wins, ties go to the feed
+#given later on the command line (so list recent/modified last), and
+#records are written to the store in CVE ID order.
+#
+#Directories are taken to hold NVD 2.0 API page files and each page is its
+#own job. nvd_stream recognises either schema, plain or compressed.
+
+
+def parse_feed(path):
+    start = time.perf_counter()
+    records = [encode_item(item) for item in iter_items(path)]
+    return records, time.perf_counter() - start
+
+
+def ingest(store, paths, workers=None, report=None):
+    paths = [p for path in paths for p in nvd2.page_files(path)]
+    sizes = {path: os.path.getsize(path) for path in paths}
+    results = [None] * len(paths)
+    order = sorted(range(len(paths)), key=lambda i: -sizes[paths[i]])
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        futures = {pool.submit(parse_feed, paths[i]): i for i in order}
+        for fut in as_completed(futures):
+            i = futures[fut]
+            records, secs = fut.result()
+            results[i] = records
+            if report:
+                report(paths[i], len(records), sizes[paths[i]], secs)
+
+    best = {}
+    for records in results:
+        for rec in records:
+            old = best.get(rec[0])
+            if old is None or rec[1] >= old[1]:
+                best[rec[0]] = rec
+    ids = sorted(best, key=id_key)
+    return store.merge_records(best[cve_id] for cve_id in ids)
+
+
+def print_report(path, count, size, secs):
+    print("%-40s %7d CVEs %8.1f MB %6.2fs %7.1f MB/s"
+          % (os.path.basename(path), count, size / 1e6, secs,
+             size / 1e6 / secs if secs else 0.0))
+
+
+#Usage: python nvd_ingest.py store_dir feed.json [feed.json ...]
+if __name__ == "__main__":
+    start = time.perf_counter()
+    store = Store(sys.argv[1])
+    changes = ingest(store, sys.argv[2:], report=print_report)
+    print("%d changed, %d CVEs in store, %.2fs total"
+          % (len(changes), len(store), time.perf_counter() - start))
@@ -0,0 +1,95 @@
+import random
+import sys
+import time
+from array import array
+
+#Minimal perfect hash over integer keys (CVE IDs through
+#nvd_cache.encode_id), built with hash and displace:
+#
+#  - every key hashes to one of n buckets (n = number of keys)
+#  - buckets are placed largest first; a bucket with several keys searches
+#    for a seed that sends all of them to free, distinct slots
+#  - a bucket with one key just takes the next free slot directly
+#
+#The result is two uint32 arrays of n entries: per bucket either a seed or
+#DIRECT | slot, and per slot the value (cache row) stored for that key. A
+#lookup is two hashes and two array reads, and both arrays can live as
+#columns of the mmap'd nvd_cache file.
+#
+#The build does not meet the "well under a second" target for 200k keys: it
+#is pure Python with no numpy to vectorize the bucket hashing, and takes
+#about 1.8s here. Batching the displacement search per bucket size through
+#list comprehensions was tried and came out slower. The build only runs
+#when the cache is rebuilt; lookups are unaffected.
+
+DIRECT = 1 << 31
+M64 = (1 << 64) - 1
+
+
+def _hash(key, seed, n):
+    #splitmix64 finalizer over key + seed; a single multiply leaves the low
+    #bits, which % n keeps for small n, too weakly mixed to separate a bucket
+    z = (key + (seed + 1) * 0x9E3779B97F4A7C15) & M64
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & M64
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & M64
+    return (z ^ (z >> 31)) % n
+
+
+def build(keys, values):
+    #keys must be distinct; returns (seeds, slots)
+    n = len(keys)
+    seeds = array('I', bytes(4 * n))
+    slots = array('I', bytes(4 * n))
+    if n == 0:
+        return seeds, slots
+    buckets = {}
+    for i, key in enumerate(keys):
+        buckets.setdefault(_hash(key, 0, n), []).append(i)
+    multi = sorted((b for b, m in buckets.items() if len(m) > 1),
+                   key=lambda b: -len(buckets[b]))
+
+    taken = bytearray(n)
+    for b in multi:
+        members = buckets[b]
+        mkeys = [keys[i] for i in members]
+        seed = 1
+        while True:
+            pos = [_hash(k, seed, n) for k in mkeys]
+            if len(set(pos)) == len(pos) and not any(taken[p] for p in pos):
+                break
+            seed += 1
+        seeds[b] = seed
+        for i, p in zip(members, pos):
+            taken[p] = 1
+            slots[p] = values[i]
+
+    #single key buckets fill the remaining slots in order
+    free = (p for p in range(n) if not taken[p])
+    for b, members in buckets.items():
+        if len(members) == 1:
+            p = next(free)
+            seeds[b] = DIRECT | p
+            slots[p] = values[members[0]]
+    return seeds, slots
+
+
+def lookup(seeds, slots, key):
+    #value stored for key; for keys that were not in the build set this is
+    #some other key's value, so callers check the key at the returned row
+    n = len(seeds)
+    if n == 0:
+        return -1
+    d = seeds[_hash(key, 0, n)]
+    slot = d & ~DIRECT if d & DIRECT else _hash(key, d, n)
+    return slots[slot]
+
+
+#Usage: python nvd_mph.py [number of keys]
+if __name__ == "__main__":
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+    keys = random.Random(1).sample(range(1 << 30), n)
+    start = time.perf_counter()
+    seeds, slots = build(keys, list(range(n)))
+    print("built for %d keys in %.3fs" % (n, time.perf_counter() - start))
+    assert all(lookup(seeds, slots, k) == i for i, k in enumerate(keys))
+    assert sorted(slots) == list(range(n))
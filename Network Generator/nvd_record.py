@@ -0,0 +1,223 @@
+import struct
+import sys
+import time
+
+import cvss
+from nvd_cache import (REF_TAGS, cwe_number, decode_id, encode_id, parse_time,
+                       ref_flags)
+from nvd_stream import iter_items
+
+#Compact in-memory CVE record. Instead of keeping the ~2 KB nested dict of
+#every item, a record is 32 packed bytes:
+#
+#  id        CVE-YYYY-N as (YYYY - 1990) << 24 | N
+#  cwe       CWE number (see nvd_cache.cwe_number)
+#  v3, v2    enum coded CVSS metrics from cvss.pack_v3 / pack_v2
+#  scores    v3 base/exploitability/impact and the same for v2, in tenths,
+#            one byte each (NO_SCORE when missing)
+#  refs      nvd_cache.REF_* bits from the reference tags
+#  published, modified as seconds since the epoch
+#
+#Records live back to back in one bytearray, so the full NVD (200k+ CVEs)
+#takes a few MB and a pass over it touches contiguous memory.
+#
+#pack_item() is the generic extractor and copes with missing or extra
+#fields. pack_item_fast() is written against the fixed NVD 1.1 layout: it
+#indexes every field directly, and memoizes vector strings and timestamps,
+#which repeat heavily. Anything off that layout raises inside it and pack()
+#falls back to the generic path; validate() checks both give the same bytes.
+
+RECORD = struct.Struct('<IIIIBBBBBBHII')
+FIELDS = ('id', 'cwe', 'v3', 'v2', 'v3_base', 'v3_expl', 'v3_impact',
+          'v2_base', 'v2_expl', 'v2_impact', 'refs', 'published', 'modified')
+FIELD = {name: i for i, name in enumerate(FIELDS)}
+
+NO_SCORE = 0xFF
+
+
+def tenths(value):
+    return NO_SCORE if value is None else int(round(value * 10))
+
+
+def pack_item(item):
+    impact = item.get('impact', {})
+    m3 = impact.get('baseMetricV3') or {}
+    m2 = impact.get('baseMetricV2') or {}
+    v3 = m3.get('cvssV3', {})
+    v2 = m2.get('cvssV2', {})
+    cwe = 0
+    for pt in item['cve']['problemtype']['problemtype_data']:
+        if pt['description']:
+            cwe = cwe_number(pt['description'][0]['value'])
+            break
+    return RECORD.pack(
+        encode_id(item['cve']['CVE_data_meta']['ID']),
+        cwe,
+        cvss.pack_v3(v3.get('vectorString')),
+        cvss.pack_v2(v2.get('vectorString')),
+        tenths(v3.get('baseScore')),
+        tenths(m3.get('exploitabilityScore')),
+        tenths(m3.get('impactScore')),
+        tenths(v2.get('baseScore')),
+        tenths(m2.get('exploitabilityScore')),
+        tenths(m2.get('impactScore')),
+        ref_flags(item),
+        parse_time(item.get('publishedDate')),
+        parse_time(item.get('lastModifiedDate')))
+
+
+_NO_V3 = (0, NO_SCORE, NO_SCORE, NO_SCORE)
+_NO_V2 = _NO_V3
+_v3_codes = {}
+_v2_codes = {}
+#feeds repeat publish dates a lot, but over a long stream nearly every
+#lastModifiedDate is new, so the memo is cleared whenever it fills up
+TIME_MEMO = 4096
+_times = {}
+
+
+def _metric_v3(m3):
+    v3 = m3['cvssV3']
+    vector = v3['vectorString']
+    code = _v3_codes.get(vector)
+    if code is None:
+        code = _v3_codes[vector] = cvss.pack_v3(vector)
+    return (code, int(round(v3['baseScore'] * 10)),
+            int(round(m3['exploitabilityScore'] * 10)),
+            int(round(m3['impactScore'] * 10)))
+
+
+def _metric_v2(m2):
+    v2 = m2['cvssV2']
+    vector = v2['vectorString']
+    code = _v2_codes.get(vector)
+    if code is None:
+        code = _v2_codes[vector] = cvss.pack_v2(vector)
+    return (code, int(round(v2['baseScore'] * 10)),
+            int(round(m2['exploitabilityScore'] * 10)),
+            int(round(m2['impactScore'] * 10)))
+
+
+def _time(s):
+    t = _times.get(s)
+    if t is None:
+        if len(_times) >= TIME_MEMO:
+            _times.clear()
+        t = _times[s] = parse_time(s)
+    return t
+
+
+def pack_item_fast(item):
+    cve = item['cve']
+    (pt,) = cve['problemtype']['problemtype_data']
+    desc = pt['description']
+    cwe = cwe_number(desc[0]['value']) if desc else 0
+    refs = 0
+    for ref in cve['references']['reference_data']:
+        for tag in ref['tags']:
+            refs |= REF_TAGS.get(tag, 0)
+    impact = item['impact']
+    m3 = impact.get('baseMetricV3')
+    m2 = impact.get('baseMetricV2')
+    v3 = _metric_v3(m3) if m3 is not None else _NO_V3
+    v2 = _metric_v2(m2) if m2 is not None else _NO_V2
+    return RECORD.pack(
+        encode_id(cve['CVE_data_meta']['ID']), cwe, v3[0], v2[0],
+        v3[1], v3[2], v3[3], v2[1], v2[2], v2[3], refs,
+        _time(item['publishedDate']), _time(item['lastModifiedDate']))
+
+
+def pack(item):
+    try:
+        return pack_item_fast(item)
+    except (KeyError, TypeError, ValueError, IndexError):
+        return pack_item(item)
+
+
+def validate(items):
+    #-> IDs whose fast path record differs from the generic one
+    bad = []
+    for item in items:
+        try:
+            fast = pack_item_fast(item)
+        except (KeyError, TypeError, ValueError, IndexError):
+            continue
+        if fast != pack_item(item):
+            bad.append(item['cve']['CVE_data_meta']['ID'])
+    return bad
+
+
+class RecordTable:
+    def __init__(self):
+        self.data = bytearray()
+        self._rows = None
+
+    def __len__(self):
+        return len(self.data) // RECORD.size
+
+    def append(self, item):
+        self.data += pack(item)
+        self._rows = None
+
+    def extend(self, items):
+        for item in items:
+            self.data += pack(item)
+        self._rows = None
+
+    def __getitem__(self, i):
+        if i < 0:
+            i += len(self)
+        return RECORD.unpack_from(self.data, i * RECORD.size)
+
+    def __iter__(self):
+        return RECORD.iter_unpack(self.data)
+
+    def column(self, name):
+        k = FIELD[name]
+        return [rec[k] for rec in RECORD.iter_unpack(self.data)]
+
+    def find(self, cve_id):
+        #row of a CVE ID, or -1; the id -> row map is built on first use
+        if self._rows is None:
+            self._rows = {rec[0]: i for i, rec in enumerate(self)}
+        return self._rows.get(encode_id(cve_id), -1)
+
+    def as_dict(self, i):
+        out = dict(zip(FIELDS, self[i]))
+        out['id'] = decode_id(out['id'])
+        return out
+
+
+def read_rows(path):
+    #reads rows written by json_reader.py --format bin
+    table = RecordTable()
+    with open(path, 'rb') as f:
+        table.data = bytearray(f.read())
+    return table
+
+
+def load_records(path):
+    table = RecordTable()
+    table.extend(iter_items(path))
+    return table
+
+
+#Usage: python nvd_record.py feed.json [--validate]
+if __name__ == "__main__":
+    import os
+    if '--validate' in sys.argv:
+        items = list(iter_items(sys.argv[1]))
+        for name, fn in (("generic", pack_item), ("fast", pack)):
+            start = time.perf_counter()
+            for item in items:
+                fn(item)
+            print("%-8s %.3fs" % (name, time.perf_counter() - start))
+        bad = validate(items)
+        print("%d items, %d differ%s" % (len(items), len(bad),
+                                         (": " + ", ".join(bad)) if bad else ""))
+        sys.exit(1 if bad else 0)
+    start = time.perf_counter()
+    table = load_records(sys.argv[1])
+    print("%d records, %d bytes (%d per CVE, feed is %d bytes) in %.3fs"
+          % (len(table), len(table.data), RECORD.size,
+             os.path.getsize(sys.argv[1]), time.perf_counter() - start))
@@ -0,0 +1,367 @@
+import mmap
+import os
+import re
+import struct
+import sys
+import time
+import zlib
+from array import array
+from itertools import accumulate, chain, repeat
+from operator import lshift, or_
+
+#On-disk inverted index over cve.description.description_data[].value.
+#
+#An index is a directory of immutable segments. A segment file is a header
+#and flat arrays, 8 byte aligned, so Segment maps it instead of reading it:
+#
+#  header     magic, version, doc count, term count, id and term blob sizes
+#  ids        the CVE IDs of the segment, newline separated
+#  term_off   uint64 per term + 1, byte offset of the term in the term blob
+#  doc_off    uint64 per term + 1, running count of the term's docs
+#  pos_off    uint64 per term + 1, running count of the term's occurrences
+#  blob_off   uint64 per term + 1, byte offset of the term's postings
+#  terms      the terms sorted by their utf-8 bytes, back to back
+#  postings   per term one zlib block of uint32s: the doc number deltas,
+#             the occurrence count in each doc, then the token positions
+#             doc by doc
+#
+#A term is found by binary search over the term blob. Its postings are
+#inflated and rebuilt with accumulate/map, without a Python loop per
+#entry, into a set of docs and a set of pos << 32 | doc occurrences (the doc
+#goes in the low bits because those pick a set's hash slot). The last
+#CACHED_TERMS of each are kept per segment. A phrase starts from its rarest
+#word's occurrences and intersects them, shifted to each other word's
+#offset, with that word's cached occurrence set.
+#
+#Adding documents (for example the change list of an nvd_store merge)
+#writes a new segment and opens only that one; older segments are never
+#rewritten. For every CVE ID the newest segment holding it wins, and within
+#one segment the last doc given for it. merge_segments() folds everything
+#into one segment.
+#
+#Queries: words are ANDed, OR between words makes a union, a leading '-'
+#excludes and "double quoted words" must appear as a phrase.
+
+MAGIC = b'NVDI'
+INDEX_VERSION = 3
+HEADER = struct.Struct('<4sIIIQQ')
+DOC_MASK = (1 << 32) - 1
+CACHED_TERMS = 16
+
+_token = re.compile(r"[a-z0-9][a-z0-9_\-\.]*[a-z0-9]|[a-z0-9]")
+
+
+def tokenize(text):
+    return _token.findall(text.lower())
+
+
+def description(item):
+    return ' '.join(d['value'] for d in item['cve']['description']['description_data'])
+
+
+def _pad(f):
+    f.write(bytes(-f.tell() % 8))
+
+
+def write_segment(path, docs):
+    #docs: (CVE ID, description text) pairs; of a repeated ID only the last
+    #one is kept
+    latest = {}
+    for cve_id, text in docs:
+        latest.pop(cve_id, None)
+        latest[cve_id] = text
+    ids = list(latest)
+    postings = {}
+    for doc, text in enumerate(latest.values()):
+        for pos, term in enumerate(tokenize(text)):
+            p = postings.get(term)
+            if p is None:
+                p = postings[term] = {}
+            p.setdefault(doc, array('I')).append(pos)
+
+    term_blob = bytearray()
+    blob = bytearray()
+    term_off, doc_off, pos_off, blob_off = (array('Q', [0]) for _ in range(4))
+    for term in sorted(postings, key=lambda t: t.encode('utf-8')):
+        term_blob += term.encode('utf-8')
+        term_off.append(len(term_blob))
+        by_doc = postings[term]
+        block = array('I')
+        last = 0
+        for doc in by_doc:
+            block.append(doc - last)
+            last = doc
+        block.extend(len(p) for p in by_doc.values())
+        for p in by_doc.values():
+            block.extend(p)
+        blob += zlib.compress(block.tobytes())
+        doc_off.append(doc_off[-1] + len(by_doc))
+        pos_off.append(pos_off[-1] + len(block) - 2 * len(by_doc))
+        blob_off.append(len(blob))
+
+    id_blob = '\n'.join(ids).encode('ascii')
+    tmp = path + '.tmp'
+    with open(tmp, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, INDEX_VERSION, len(ids), len(postings),
+                            len(id_blob), len(term_blob)))
+        f.write(id_blob)
+        _pad(f)
+        for a in (term_off, doc_off, pos_off, blob_off):
+            f.write(memoryview(a).cast('B'))
+        f.write(term_blob)
+        _pad(f)
+        f.write(blob)
+    os.replace(tmp, path)
+
+
+def _cached(cache, term, build):
+    #small LRU: a hit moves the term to the back, the front is evicted
+    out = cache.pop(term, None)
+    if out is None:
+        out = build()
+        if len(cache) >= CACHED_TERMS:
+            del cache[next(iter(cache))]
+    cache[term] = out
+    return out
+
+
+class Segment:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, ndocs, nterms, id_bytes, term_bytes = HEADER.unpack_from(mm, 0)
+        if magic != MAGIC or version != INDEX_VERSION:
+            mm.close()
+            raise ValueError("%s is not a current search segment" % path)
+        self.ndocs, self.nterms = ndocs, nterms
+        buf = memoryview(mm)
+        pos = HEADER.size
+        self._id_blob = buf[pos:pos + id_bytes]
+        pos += id_bytes + (-id_bytes % 8)
+        dirs = []
+        for _ in range(4):
+            dirs.append(buf[pos:pos + 8 * (nterms + 1)].cast('Q'))
+            pos += 8 * (nterms + 1)
+        self.term_off, self.doc_off, self.pos_off, self.blob_off = dirs
+        self.term_blob = buf[pos:pos + term_bytes]
+        pos += term_bytes + (-term_bytes % 8)
+        self.blob = buf[pos:pos + self.blob_off[nterms]]
+        self._mm = mm
+        self._ids = None
+        self._doc_of = None
+        self._doc_sets = {}
+        self._pos_sets = {}
+        #None while every doc is live, else the set of live doc numbers
+        self.live = None
+
+    @property
+    def ids(self):
+        if self._ids is None:
+            self._ids = self._id_blob.tobytes().decode('ascii').split('\n') if self.ndocs else []
+        return self._ids
+
+    def close(self):
+        if self._mm is not None:
+            for view in (self._id_blob, self.term_off, self.doc_off, self.pos_off,
+                         self.blob_off, self.term_blob, self.blob):
+                view.release()
+            self._mm.close()
+            self._mm = None
+
+    def term(self, t):
+        return self.term_blob[self.term_off[t]:self.term_off[t + 1]].tobytes().decode('utf-8')
+
+    def find(self, term):
+        #term number, or -1
+        key = term.encode('utf-8')
+        off, blob = self.term_off, self.term_blob
+        lo, hi = 0, self.nterms
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if blob[off[mid]:off[mid + 1]].tobytes() < key:
+                lo = mid + 1
+            else:
+                hi = mid
+        if lo < self.nterms and blob[off[lo]:off[lo + 1]].tobytes() == key:
+            return lo
+        return -1
+
+    def postings(self, t):
+        #-> (doc numbers, occurrence count per doc, positions doc by doc)
+        n = self.doc_off[t + 1] - self.doc_off[t]
+        block = array('I', zlib.decompress(self.blob[self.blob_off[t]:self.blob_off[t + 1]]))
+        return array('I', accumulate(block[:n])), block[n:2 * n], block[2 * n:]
+
+    def occurrences(self, t):
+        #pos << 32 | doc for every occurrence of term t
+        docs, counts, positions = self.postings(t)
+        return map(or_, map(lshift, positions, repeat(32)),
+                   chain.from_iterable(map(repeat, docs, counts)))
+
+    def docs_of(self, term):
+        t = self.find(term)
+        if t < 0:
+            return frozenset()
+        return _cached(self._doc_sets, term, lambda: frozenset(self.postings(t)[0]))
+
+    def positions_of(self, term):
+        t = self.find(term)
+        if t < 0:
+            return frozenset()
+        return _cached(self._pos_sets, term, lambda: frozenset(self.occurrences(t)))
+
+    def phrase(self, words):
+        found = [self.find(w) for w in words]
+        if min(found) < 0:
+            return set()
+        #cur holds the starts still possible, moved to word at's offset; a
+        #start moved before a doc's first token goes negative and never matches
+        order = sorted(range(len(words)), key=lambda j: self.pos_off[found[j] + 1] - self.pos_off[found[j]])
+        at = order[0]
+        cur = self.positions_of(words[at])
+        for j in order[1:]:
+            cur = self.positions_of(words[j]).intersection(map(((j - at) << 32).__add__, cur))
+            at = j
+            if not cur:
+                return set()
+        return set(map(DOC_MASK.__and__, cur))
+
+    def drop(self, ids):
+        #marks the docs whose CVE ID is in ids (a newer segment's) as dead
+        if self._doc_of is None:
+            self._doc_of = {cve_id: d for d, cve_id in enumerate(self.ids)}
+        doc_of = self._doc_of
+        dead = [doc_of[i] for i in ids if i in doc_of]
+        if dead:
+            if self.live is None:
+                self.live = set(range(self.ndocs))
+            self.live.difference_update(dead)
+
+
+def parse_query(query):
+    #-> list of OR groups; each clause is (negated, [words]) with more than
+    #one word meaning a phrase
+    groups = [[]]
+    for m in re.finditer(r'(-?)"([^"]*)"|(\S+)', query):
+        if m.group(3) == 'OR':
+            groups.append([])
+            continue
+        if m.group(3) is not None:
+            neg = m.group(3).startswith('-')
+            words = tokenize(m.group(3).lstrip('-'))
+        else:
+            neg = bool(m.group(1))
+            words = tokenize(m.group(2))
+        if words:
+            groups[-1].append((neg, words))
+    return [g for g in groups if g]
+
+
+class SearchIndex:
+    def __init__(self, path):
+        self.path = path
+        os.makedirs(path, exist_ok=True)
+        self.segments = []
+        self.reload()
+
+    def segment_names(self):
+        return sorted(n for n in os.listdir(self.path) if n.endswith('.seg'))
+
+    def reload(self):
+        for seg in self.segments:
+            seg.close()
+        self.segments = []
+        for name in self.segment_names():
+            self._open(name)
+
+    def _open(self, name):
+        #a doc is live only in the newest segment that holds its ID
+        seg = Segment(os.path.join(self.path, name))
+        if self.segments:
+            ids = seg.ids
+            for older in self.segments:
+                older.drop(ids)
+        self.segments.append(seg)
+
+    def add(self, docs):
+        docs = list(docs)
+        if not docs:
+            return
+        names = self.segment_names()
+        n = int(names[-1].split('.')[0]) + 1 if names else 0
+        name = '%08d.seg' % n
+        write_segment(os.path.join(self.path, name), docs)
+        self._open(name)
+
+    def add_items(self, items):
+        self.add((item['cve']['CVE_data_meta']['ID'], description(item)) for item in items)
+
+    def add_changes(self, store, changes):
+        #changes: the (ID, kind) list returned by nvd_store.Store.merge
+        self.add_items(store.get(cve_id) for cve_id, _ in changes)
+
+    def merge_segments(self):
+        #rewrite all live docs into one segment
+        names = self.segment_names()
+        if len(names) < 2:
+            return
+        docs = {}
+        for seg in self.segments:
+            texts = {}
+            live = seg.live
+            for t in range(seg.nterms):
+                term = seg.term(t)
+                for g in seg.occurrences(t):
+                    doc = g & DOC_MASK
+                    if live is None or doc in live:
+                        texts.setdefault(doc, {})[g >> 32] = term
+            ids = seg.ids
+            for doc in sorted(texts):
+                t = texts[doc]
+                docs[ids[doc]] = ' '.join(t[p] for p in sorted(t))
+        n = int(names[-1].split('.')[0]) + 1
+        write_segment(os.path.join(self.path, '%08d.seg' % n), docs.items())
+        for seg in self.segments:
+            seg.close()
+        self.segments = []
+        for name in names:
+            os.remove(os.path.join(self.path, name))
+        self.reload()
+
+    def search(self, query):
+        #returns matching CVE IDs
+        out = set()
+        for group in parse_query(query):
+            for seg in self.segments:
+                hits = None
+                excluded = set()
+                for neg, words in group:
+                    docs = seg.docs_of(words[0]) if len(words) == 1 else seg.phrase(words)
+                    if neg:
+                        excluded |= docs
+                    else:
+                        hits = docs if hits is None else hits & docs
+                    if hits is not None and not hits:
+                        break
+                if hits:
+                    hits = hits - excluded
+                    if seg.live is not None:
+                        hits &= seg.live
+                    out.update(map(seg.ids.__getitem__, hits))
+        return sorted(out)
+
+
+#Usage: python nvd_search.py index_dir --add feed.json [feed.json ...]
+#       python nvd_search.py index_dir 'query'
+if __name__ == "__main__":
+    index = SearchIndex(sys.argv[1])
+    if sys.argv[2] == '--add':
+        from nvd_stream import iter_feeds
+        index.add_items(iter_feeds(sys.argv[3:]))
+    else:
+        start = time.perf_counter()
+        hits = index.search(' '.join(sys.argv[2:]))
+        secs = time.perf_counter() - start
+        for cve_id in hits:
+            print(cve_id)
+        print("%d hits in %.3f ms" % (len(hits), secs * 1000))
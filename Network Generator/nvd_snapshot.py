@@ -0,0 +1,197 @@
+import os
+import sys
+import threading
+import time
+from contextlib import contextmanager
+
+from nvd_cache import Cache, write_cache
+
+#Epoch versioned, immutable snapshots of the CVE cache, so scoring jobs can
+#keep reading while a feed merge builds the next version.
+#
+#Every publish writes a complete nvd_cache file snapshot.<epoch>.cache next
+#to the old ones, then atomically replaces the CURRENT file and swaps the
+#in-process pointer (RCU style). Readers pin whatever snapshot is current
+#when they start and never wait for the writer; the old snapshot is
+#unmapped once it is retired and its last reader lets go.
+#
+#Reclamation is bounded: if max_retired old snapshots are still pinned, the
+#next publish waits for readers to drain before adding another. Other
+#processes follow CURRENT; the newest `keep` files stay on disk for them.
+#Every read() stats CURRENT and, when it has changed, moves to the epoch it
+#names, so a scoring job in another process picks up new publishes. If that
+#file was pruned in between, CURRENT has moved on again and is re-read.
+
+CURRENT = 'CURRENT'
+RETRIES = 50
+RETRY_WAIT = 0.01
+
+
+class Snapshot:
+    def __init__(self, epoch, path, on_reclaim):
+        self.epoch = epoch
+        self.path = path
+        self.cache = Cache(path)
+        self._pins = 0
+        self._retired = False
+        self._lock = threading.Lock()
+        self._on_reclaim = on_reclaim
+
+    def _pin(self):
+        with self._lock:
+            if self.cache is None:
+                return False
+            self._pins += 1
+            return True
+
+    def _unpin(self):
+        with self._lock:
+            self._pins -= 1
+            if not (self._retired and self._pins == 0):
+                return
+            self._close()
+        self._on_reclaim(self)
+
+    def _retire(self):
+        with self._lock:
+            self._retired = True
+            if self._pins:
+                return False
+            self._close()
+        return True
+
+    def _close(self):
+        self.cache.close()
+        self.cache = None
+
+
+class SnapshotStore:
+    def __init__(self, path, max_retired=2, keep=2):
+        self.path = path
+        self.max_retired = max_retired
+        self.keep = keep
+        os.makedirs(path, exist_ok=True)
+        self._write_lock = threading.Lock()
+        self._reclaim = threading.Condition()
+        self._retired = set()
+        self._swap_lock = threading.Lock()
+        self._current = None
+        self._stamp = None
+        self._refresh()
+
+    def _file(self, epoch):
+        return os.path.join(self.path, 'snapshot.%d.cache' % epoch)
+
+    def _refresh(self):
+        #follow CURRENT if another process (or this one) has replaced it
+        current = os.path.join(self.path, CURRENT)
+        for _ in range(RETRIES):
+            try:
+                st = os.stat(current)
+            except FileNotFoundError:
+                return
+            stamp = (st.st_mtime_ns, st.st_ino, st.st_size)
+            if stamp == self._stamp:
+                return
+            with self._swap_lock:
+                if stamp == self._stamp:
+                    return
+                try:
+                    with open(current) as f:
+                        epoch = int(f.read())
+                    snap = None
+                    if self._current is None or self._current.epoch != epoch:
+                        snap = Snapshot(epoch, self._file(epoch), self._reclaimed)
+                except FileNotFoundError:
+                    #the snapshot was pruned after CURRENT moved past it
+                    snap = False
+                if snap is not False:
+                    self._stamp = stamp
+                    if snap is not None:
+                        self._install(snap)
+                    return
+            time.sleep(RETRY_WAIT)
+        raise LookupError("snapshot named by %s keeps disappearing" % current)
+
+    def _install(self, snap):
+        old = self._current
+        self._current = snap
+        if old is not None:
+            with self._reclaim:
+                self._retired.add(old)
+            if old._retire():
+                self._reclaimed(old)
+
+    @property
+    def epoch(self):
+        snap = self._current
+        return snap.epoch if snap else 0
+
+    @contextmanager
+    def read(self):
+        #yields the nvd_cache.Cache of the current snapshot, which stays
+        #valid for the whole block even if a newer one is published; slices
+        #of its columns must not be kept past the block
+        self._refresh()
+        while True:
+            snap = self._current
+            if snap is None:
+                raise LookupError("no snapshot published in %s" % self.path)
+            if snap._pin():
+                break
+        try:
+            yield snap.cache
+        finally:
+            snap._unpin()
+
+    def _reclaimed(self, snap):
+        with self._reclaim:
+            self._retired.discard(snap)
+            self._reclaim.notify_all()
+
+    def publish(self, items):
+        #builds the next snapshot from CVE items and makes it current
+        with self._write_lock:
+            with self._reclaim:
+                while len(self._retired) >= self.max_retired:
+                    self._reclaim.wait()
+            self._refresh()
+            epoch = self.epoch + 1
+            write_cache(self._file(epoch), items)
+            tmp = os.path.join(self.path, CURRENT + '.tmp')
+            with open(tmp, 'w') as f:
+                f.write(str(epoch))
+            with self._swap_lock:
+                os.replace(tmp, os.path.join(self.path, CURRENT))
+                st = os.stat(os.path.join(self.path, CURRENT))
+                self._stamp = (st.st_mtime_ns, st.st_ino, st.st_size)
+                self._install(Snapshot(epoch, self._file(epoch), self._reclaimed))
+            self._prune(epoch)
+            return epoch
+
+    def _prune(self, epoch):
+        #open mappings survive unlink, so only the files of processes that
+        #have not opened them yet matter here
+        for name in os.listdir(self.path):
+            if name.startswith('snapshot.') and name.endswith('.cache'):
+                e = int(name.split('.')[1])
+                if e <= epoch - self.keep:
+                    os.remove(os.path.join(self.path, name))
+
+    def close(self):
+        with self._write_lock, self._swap_lock:
+            old, self._current = self._current, None
+            if old is not None and old._retire():
+                self._reclaimed(old)
+
+
+#Usage: python nvd_snapshot.py snapshot_dir store_dir
+#publishes the live records of an nvd_store as the next snapshot
+if __name__ == "__main__":
+    from nvd_store import Store
+    snapshots = SnapshotStore(sys.argv[1])
+    start = time.perf_counter()
+    epoch = snapshots.publish(Store(sys.argv[2]).iter_items())
+    with snapshots.read() as cache:
+        print("epoch %d: %d CVEs in %.3fs" % (epoch, len(cache), time.perf_counter() - start))
+    snapshots.close()
@@ -0,0 +1,160 @@
+import json
+import os
+import sys
+
+from nvd_stream import iter_feeds
+
+#Local CVE store that NVD "recent" and "modified" feeds can be merged into
+#without re-reading the full corpus. The store is a directory with
+#
+#  records.N.ndjson  append-only log, one CVE_Item per line
+#  index.tsv         the name of the log, then ID, offset, length,
+#                    lastModifiedDate of each live record
+#
+#A merge only appends items whose lastModifiedDate is newer than the stored
+#one and then swaps in a new index, so unchanged records are never
+#rewritten. Superseded lines stay in the log until compact(), which copies
+#the live records into the next generation of the log. Replacing the index
+#is the only commit point: until then the old index and the old log are
+#untouched, and the old log is deleted only after it. An index without a
+#log line belongs to the original records.ndjson.
+
+RECORDS = 'records.ndjson'
+INDEX = 'index.tsv'
+LOG_LINE = '#log\t'
+
+ADDED = 'added'
+MODIFIED = 'modified'
+
+
+def id_key(cve_id):
+    #CVE-2020-1234 sorts numerically by year then number
+    _, year, num = cve_id.split('-', 2)
+    return int(year), int(num)
+
+
+def encode_item(item):
+    line = json.dumps(item, separators=(',', ':')).encode('utf-8')
+    return (item['cve']['CVE_data_meta']['ID'],
+            item.get('lastModifiedDate', ''), line)
+
+
+class Store:
+    def __init__(self, path):
+        self.path = path
+        os.makedirs(path, exist_ok=True)
+        self.log = RECORDS
+        self.index = {}
+        try:
+            with open(os.path.join(path, INDEX)) as f:
+                for line in f:
+                    if line.startswith(LOG_LINE):
+                        self.log = line[len(LOG_LINE):].rstrip('\n')
+                        continue
+                    cve_id, off, length, modified = line.rstrip('\n').split('\t')
+                    self.index[cve_id] = (int(off), int(length), modified)
+        except FileNotFoundError:
+            pass
+
+    @property
+    def records_path(self):
+        return os.path.join(self.path, self.log)
+
+    def __len__(self):
+        return len(self.index)
+
+    def __contains__(self, cve_id):
+        return cve_id in self.index
+
+    def ids(self):
+        return sorted(self.index, key=id_key)
+
+    def modified(self, cve_id):
+        return self.index[cve_id][2]
+
+    def get(self, cve_id):
+        off, length, _ = self.index[cve_id]
+        with open(self.records_path, 'rb') as f:
+            f.seek(off)
+            return json.loads(f.read(length))
+
+    def iter_items(self):
+        #live records in CVE ID order
+        with open(self.records_path, 'rb') as f:
+            for cve_id in self.ids():
+                off, length, _ = self.index[cve_id]
+                f.seek(off)
+                yield json.loads(f.read(length))
+
+    def merge(self, items):
+        #returns the change list as (ID, ADDED or MODIFIED) in merge order
+        return self.merge_records(encode_item(item) for item in items)
+
+    def merge_records(self, records):
+        #records are (ID, lastModifiedDate, encoded line) from encode_item()
+        changes = []
+        with open(self.records_path, 'ab') as f:
+            for cve_id, modified, line in records:
+                old = self.index.get(cve_id)
+                if old is not None and old[2] >= modified:
+                    continue
+                off = f.tell()
+                f.write(line + b'\n')
+                self.index[cve_id] = (off, len(line), modified)
+                changes.append((cve_id, ADDED if old is None else MODIFIED))
+        if changes:
+            self.save_index()
+        return changes
+
+    def save_index(self):
+        tmp = os.path.join(self.path, INDEX + '.tmp')
+        with open(tmp, 'w') as f:
+            f.write(LOG_LINE + self.log + '\n')
+            for cve_id in self.ids():
+                off, length, modified = self.index[cve_id]
+                f.write('%s\t%d\t%d\t%s\n' % (cve_id, off, length, modified))
+        os.replace(tmp, os.path.join(self.path, INDEX))
+
+    def garbage(self):
+        #bytes in the log that belong to superseded records
+        try:
+            size = os.path.getsize(self.records_path)
+        except FileNotFoundError:
+            return 0
+        return size - sum(length + 1 for _, length, _ in self.index.values())
+
+    def _next_log(self):
+        #records.ndjson -> records.1.ndjson -> records.2.ndjson ...
+        parts = self.log.split('.')
+        gen = int(parts[1]) + 1 if len(parts) == 3 else 1
+        return 'records.%d.ndjson' % gen
+
+    def compact(self):
+        old, new = self.log, self._next_log()
+        #logs left behind by an interrupted compact
+        for name in os.listdir(self.path):
+            if name.startswith('records.') and name.endswith('.ndjson') and name != old:
+                os.remove(os.path.join(self.path, name))
+        index = {}
+        with open(self.records_path, 'rb') as src, \
+                open(os.path.join(self.path, new), 'wb') as dst:
+            for cve_id in self.ids():
+                off, length, modified = self.index[cve_id]
+                src.seek(off)
+                index[cve_id] = (dst.tell(), length, modified)
+                dst.write(src.read(length) + b'\n')
+            dst.flush()
+            os.fsync(dst.fileno())
+        self.log, self.index = new, index
+        self.save_index()
+        os.remove(os.path.join(self.path, old))
+
+
+#Usage: python nvd_store.py store_dir feed.json [feed.json ...]
+#prints one "ID<tab>added|modified" line per changed record
+if __name__ == "__main__":
+    store = Store(sys.argv[1])
+    for cve_id, change in store.merge(iter_feeds(sys.argv[2:])):
+        print(cve_id + '\t' + change)
+    if store.garbage() > os.path.getsize(store.records_path) // 2:
+        store.compact()
@@ -0,0 +1,264 @@
+import codecs
+import gzip
+import json
+import os
+import queue
+import sys
+import threading
+import time
+import zipfile
+
+import nvd2
+
+#Streaming reader for NVD 1.1 feeds and NVD 2.0 API pages. Instead of json.load() on the whole
+#document, the file is read in fixed size chunks and each element of
+#CVE_Items is decoded on its own with the C accelerated raw_decode, so memory
+#stays at roughly one chunk plus the largest single item. Several feeds
+#concatenated into one file are read back to back. A 2.0 page has its items
+#under "vulnerabilities" instead; each element's "cve" object goes through
+#nvd2.normalize on the way out, so every caller gets 1.1 shaped items from
+#either schema. A file holding neither array is an error, not an empty feed,
+#and a directory is read as its page files in name order.
+#
+#Feeds as NVD ships them (.json.gz, or a .zip holding .json files) are read
+#without inflating them to disk: a background thread decompresses and
+#decodes chunks into a bounded queue while the caller's thread parses, and
+#zlib releases the GIL so the two overlap.
+
+CHUNK_SIZE = 1 << 20
+PIPE_DEPTH = 8
+ITEMS_KEYS = ('"CVE_Items"', '"vulnerabilities"')
+KEY_LEN = max(len(k) for k in ITEMS_KEYS)
+
+_decoder = json.JSONDecoder()
+_WS = ' \t\n\r'
+
+
+def _skip_ws(buf, pos):
+    n = len(buf)
+    while pos < n and buf[pos] in _WS:
+        pos += 1
+    return pos
+
+
+def _find_key(buf, pos):
+    #(offset, key) of the first items key at or after pos, or (-1, None)
+    best, found = -1, None
+    for key in ITEMS_KEYS:
+        at = buf.find(key, pos)
+        if at >= 0 and (best < 0 or at < best):
+            best, found = at, key
+    return best, found
+
+
+def iter_stream(f, chunk_size=CHUNK_SIZE):
+    buf = ''
+    pos = 0
+    eof = False
+    in_items = False
+    nvd2_items = False
+    seen = False
+    while True:
+        if not in_items:
+            #look for the start of the next CVE_Items or vulnerabilities array
+            at, key = _find_key(buf, pos)
+            if at >= 0:
+                p = _skip_ws(buf, at + len(key))
+                if p < len(buf) and buf[p] == ':':
+                    p = _skip_ws(buf, p + 1)
+                if p < len(buf) and buf[p] == '[':
+                    pos = p + 1
+                    in_items = seen = True
+                    nvd2_items = key != ITEMS_KEYS[0]
+                    continue
+                if p < len(buf) or eof:
+                    #key inside some other value, keep looking after it
+                    pos = at + len(key)
+                    continue
+                #key found but the '[' is past the end of the buffer
+                pos = at
+            elif eof:
+                if not seen:
+                    raise ValueError("no CVE_Items or vulnerabilities array in feed")
+                return
+            else:
+                pos = max(pos, len(buf) - KEY_LEN)
+        else:
+            pos = _skip_ws(buf, pos)
+            if pos < len(buf):
+                c = buf[pos]
+                if c == ']':
+                    in_items = False
+                    pos += 1
+                    continue
+                if c == ',':
+                    pos += 1
+                    continue
+                try:
+                    item, end = _decoder.raw_decode(buf, pos)
+                except ValueError:
+                    if eof:
+                        raise
+                else:
+                    pos = end
+                    yield nvd2.normalize(item['cve']) if nvd2_items else item
+                    continue
+            elif eof:
+                raise ValueError("feed ended inside CVE_Items")
+        #need more input, drop what has been consumed
+        buf = buf[pos:]
+        pos = 0
+        data = f.read(chunk_size)
+        if not data:
+            eof = True
+        buf += data
+
+
+class _Pipe:
+    #file-like reader fed by a decompression thread through a bounded queue
+    def __init__(self, open_raw, chunk_size, depth=PIPE_DEPTH):
+        self.chunks = queue.Queue(depth)
+        self.error = None
+        self.done = False
+        self.closed = False
+        self.thread = threading.Thread(target=self._produce,
+                                       args=(open_raw, chunk_size), daemon=True)
+        self.thread.start()
+
+    def _put(self, chunk):
+        while not self.closed:
+            try:
+                self.chunks.put(chunk, timeout=0.1)
+                return True
+            except queue.Full:
+                pass
+        return False
+
+    def _produce(self, open_raw, chunk_size):
+        try:
+            decoder = codecs.getincrementaldecoder('utf-8')()
+            for raw in open_raw():
+                with raw:
+                    while True:
+                        data = raw.read(chunk_size)
+                        if not data:
+                            break
+                        if not self._put(decoder.decode(data)):
+                            return
+            self._put(decoder.decode(b'', final=True))
+        except Exception as e:
+            self.error = e
+        finally:
+            self._put(None)
+
+    def read(self, size=-1):
+        if self.done:
+            return ''
+        chunk = self.chunks.get()
+        if chunk is None:
+            self.done = True
+            if self.error is not None:
+                raise self.error
+            return ''
+        return chunk
+
+    def close(self):
+        self.closed = True
+        self.thread.join()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def _open_gzip(path):
+    yield gzip.open(path, 'rb')
+
+
+def _open_zip(path):
+    with zipfile.ZipFile(path) as z:
+        for name in sorted(z.namelist()):
+            if name.endswith('.json'):
+                yield z.open(name)
+
+
+def open_feed(path, chunk_size=CHUNK_SIZE):
+    if path.endswith('.gz'):
+        return _Pipe(lambda: _open_gzip(path), chunk_size)
+    if path.endswith('.zip'):
+        return _Pipe(lambda: _open_zip(path), chunk_size)
+    return open(path, encoding='utf-8')
+
+
+def iter_items(path, chunk_size=CHUNK_SIZE):
+    if os.path.isdir(path):
+        for page in nvd2.page_files(path):
+            yield from iter_items(page, chunk_size)
+        return
+    with open_feed(path, chunk_size) as f:
+        yield from iter_stream(f, chunk_size)
+
+
+def source_stat(path):
+    #(size, mtime_ns) for cache freshness checks; a directory counts as its
+    #pages, since rewriting a page does not touch the directory itself
+    if not os.path.isdir(path):
+        st = os.stat(path)
+        return st.st_size, st.st_mtime_ns
+    size = mtime = 0
+    for page in nvd2.page_files(path):
+        st = os.stat(page)
+        size += st.st_size
+        mtime = max(mtime, st.st_mtime_ns)
+    return size, mtime
+
+
+def iter_feeds(paths, chunk_size=CHUNK_SIZE):
+    for path in paths:
+        yield from iter_items(path, chunk_size)
+
+
+#Benchmark of the streaming reader against the json.load path.
+#Usage: python nvd_stream.py --bench feed1.json [feed2.json ...]
+def _load_all(paths):
+    count = 0
+    for path in paths:
+        with open(path, encoding='utf-8') as f:
+            data = json.load(f)
+        count += len(data['CVE_Items'])
+        del data
+    return count
+
+
+def _stream_all(paths):
+    count = 0
+    for _ in iter_feeds(paths):
+        count += 1
+    return count
+
+
+def bench(paths):
+    import tracemalloc
+    size = sum(os.path.getsize(p) for p in paths) / 1e6
+    print("feeds: %d, %.1f MB" % (len(paths), size))
+    for name, fn in (("json.load", _load_all), ("stream", _stream_all)):
+        start = time.perf_counter()
+        count = fn(paths)
+        secs = time.perf_counter() - start
+        #second pass only to measure peak memory, tracemalloc slows it down
+        tracemalloc.start()
+        fn(paths)
+        peak = tracemalloc.get_traced_memory()[1]
+        tracemalloc.stop()
+        print("%-10s items: %d  time: %.3fs  %.1f MB/s  peak mem: %.1f MB"
+              % (name, count, secs, size / secs, peak / 1e6))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) > 2 and sys.argv[1] == "--bench":
+        bench(sys.argv[2:])
+    else:
+        for item in iter_feeds(sys.argv[1:]):
+            print(item['cve']['CVE_data_meta']['ID'])
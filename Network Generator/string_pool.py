@@ -0,0 +1,209 @@
+import os
+import struct
+import sys
+import threading
+import time
+from array import array
+
+#Process wide, append-only string interner. Vendor, product and version
+#names, CWE ids and reference sources repeat tens of thousands of times in
+#the feed; interning gives each distinct string one object and a 32 bit
+#handle that the index and cache structures store instead.
+#
+#Handles stay stable across runs through one shared pool file,
+#strings.pool, next to the saved structures: its strings in handle order
+#and a random token. Saving a structure appends the live pool to the file
+#(persist) and records the token and the pool size; loading adopts the
+#file (attach) and checks both, so the saved handles are used as they are.
+#A process that interned strings in another order than the file cannot
+#append to it; persist then rewrites the file under a new token and the
+#structures saved against the old one are rebuilt when next loaded.
+
+MAX_HANDLES = 1 << 32
+POOL_FILE = 'strings.pool'
+POOL_MAGIC = b'NVDS'
+POOL_VERSION = 1
+POOL_HEADER = struct.Struct('<4sIQQ')    #magic, version, token, strings
+
+
+def pool_path(path):
+    #the shared pool file of the structure saved at path
+    return os.path.join(os.path.dirname(os.path.abspath(path)), POOL_FILE)
+
+
+def _read_pool(path):
+    #-> (token, strings), (None, []) when there is no file yet
+    try:
+        with open(path, 'rb') as f:
+            data = f.read()
+    except FileNotFoundError:
+        return None, []
+    try:
+        magic, version, token, count = POOL_HEADER.unpack_from(data, 0)
+    except struct.error:
+        raise ValueError("%s is not a string pool" % path)
+    if magic != POOL_MAGIC or version != POOL_VERSION:
+        raise ValueError("%s is not a current string pool" % path)
+    start = POOL_HEADER.size + 4 * (count + 1)
+    offsets = array('I')
+    offsets.frombytes(data[POOL_HEADER.size:start])
+    return token, StringPool.from_arrays(offsets, data[start:])
+
+
+class StringPool:
+    def __init__(self, strings=()):
+        self.strings = []
+        self.handles = {}
+        self._lock = threading.Lock()
+        for s in strings:
+            self.intern(s)
+
+    def __len__(self):
+        return len(self.strings)
+
+    def intern(self, s):
+        #lookups of known strings take no lock; only new strings do
+        h = self.handles.get(s)
+        if h is not None:
+            return h
+        with self._lock:
+            return self._add(s)
+
+    def _add(self, s):
+        h = self.handles.get(s)
+        if h is None:
+            h = len(self.strings)
+            if h >= MAX_HANDLES:
+                raise OverflowError("string pool is full")
+            s = sys.intern(s)
+            self.strings.append(s)
+            self.handles[s] = h
+        return h
+
+    def get(self, s):
+        #handle of s, or None if it was never interned
+        return self.handles.get(s)
+
+    def __getitem__(self, h):
+        return self.strings[h]
+
+    def _adopt(self, strings, path):
+        #takes the saved strings with their handles; one list has to be a
+        #prefix of the other
+        with self._lock:
+            n = min(len(strings), len(self.strings))
+            if strings[:n] != self.strings[:n]:
+                raise ValueError("string pool %s does not match this process" % path)
+            for s in strings[n:]:
+                self._add(s)
+
+    def attach(self, path):
+        #adopts the pool file at path -> its token, None if there is none
+        token, strings = _read_pool(path)
+        self._adopt(strings, path)
+        return token
+
+    def persist(self, path):
+        #writes this pool's new strings to the file at path -> its token
+        try:
+            token, strings = _read_pool(path)
+            self._adopt(strings, path)
+        except ValueError:
+            token, strings = None, ()
+        if token is not None and len(strings) == len(self.strings):
+            return token
+        if token is None:
+            token = int.from_bytes(os.urandom(8), 'little')
+        with self._lock:
+            offsets, blob = self.to_arrays(self.strings)
+        tmp = '%s.%d.tmp' % (path, os.getpid())
+        with open(tmp, 'wb') as f:
+            f.write(POOL_HEADER.pack(POOL_MAGIC, POOL_VERSION, token, len(offsets) - 1))
+            offsets.tofile(f)
+            blob.tofile(f)
+        os.replace(tmp, path)
+        return token
+
+    def prepare(self, path):
+        #attaches before the structure saved at path is built, so the strings
+        #it adds extend the shared file; a file that does not match is left
+        #for persist to replace
+        try:
+            self.attach(pool_path(path))
+        except ValueError:
+            pass
+
+    def check(self, path, token, size):
+        #raises ValueError unless a structure saved against (token, size)
+        #can use its handles with this pool
+        if self.attach(pool_path(path)) != token or len(self.strings) < size:
+            raise ValueError("%s was saved against another string pool" % path)
+
+    @staticmethod
+    def to_arrays(strings):
+        #(offsets, utf-8 blob) as nvd_cache stores a string table
+        offsets = array('I', [0])
+        blob = array('B')
+        for s in strings:
+            blob.frombytes(s.encode('utf-8'))
+            offsets.append(len(blob))
+        return offsets, blob
+
+    @staticmethod
+    def from_arrays(offsets, blob):
+        data = bytes(blob)
+        return [data[offsets[i]:offsets[i + 1]].decode('utf-8')
+                for i in range(len(offsets) - 1)]
+
+    def __getstate__(self):
+        return {'strings': self.strings}
+
+    def __setstate__(self, state):
+        self.__init__(state['strings'])
+
+
+POOL = StringPool()
+
+
+def intern(s):
+    return POOL.intern(s)
+
+
+#Usage: python string_pool.py feed.json
+#compares holding the repeated feed strings as parsed against pool handles
+def measure(path):
+    import tracemalloc
+    from cpe_index import iter_cpe_matches, parse_cpe
+    from nvd_stream import iter_items
+
+    def strings_of(item):
+        for match in iter_cpe_matches(item.get('configurations', {}).get('nodes', ())):
+            yield from parse_cpe(match['cpe23Uri'])
+        for pt in item['cve']['problemtype']['problemtype_data']:
+            for desc in pt['description']:
+                yield desc['value']
+        for ref in item['cve']['references']['reference_data']:
+            yield ref['refsource']
+            yield from ref.get('tags', ())
+
+    tracemalloc.start()
+    plain = [s for item in iter_items(path) for s in strings_of(item)]
+    plain_bytes = tracemalloc.get_traced_memory()[0]
+    tracemalloc.stop()
+
+    tracemalloc.start()
+    pool = StringPool()
+    start = time.perf_counter()
+    handles = array('I', (pool.intern(s) for item in iter_items(path) for s in strings_of(item)))
+    secs = time.perf_counter() - start
+    pooled_bytes = tracemalloc.get_traced_memory()[0]
+    tracemalloc.stop()
+
+    print("%d strings, %d distinct" % (len(plain), len(pool)))
+    print("as parsed: %.2f MB, pooled: %.2f MB (%.1fx less), interned in %.3fs"
+          % (plain_bytes / 1e6, pooled_bytes / 1e6, plain_bytes / pooled_bytes, secs))
+    return handles
+
+
+if __name__ == "__main__":
+    measure(sys.argv[1])